@@ -0,0 +1,69 @@
+#include <log.h>
+#include "spdlog/cfg/argv.h"
+#include <util.h>
+
+#include <forecast/daemon.h>
+#include <forecast/sim_backend.h>
+
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Share the board between processes, see DaemonClient:
+//
+//   forecastd [--socket=<path>] [--simulated] <bitstream>...
+//
+// --simulated schedules on a SimBackend, to try clients without a board.
+int main(int argc, char** argv)
+{
+  spdlog::set_pattern("[%H:%M:%S] [%^%L%$] [%t] %v");
+  spdlog::cfg::load_argv_levels(argc, argv);
+
+  constexpr char flag[] = "--socket=";
+  std::string    path   = forecast::daemon_socket_path();
+  bool           simulated = false;
+  std::vector<std::string> bitstreams;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], flag, sizeof(flag) - 1) == 0) {
+      path = argv[i] + sizeof(flag) - 1;
+    } else if (std::strcmp(argv[i], "--simulated") == 0) {
+      simulated = true;
+    } else if (std::strncmp(argv[i], "SPDLOG", 6) != 0) {
+      bitstreams.push_back(argv[i]);
+    }
+  }
+  if (bitstreams.empty()) {
+    critical("Usage: {} [--socket=<path>] [--simulated] <bitstream>...",
+             argv[0]);
+    return 1;
+  }
+
+  // Until SIGINT or SIGTERM, the daemon shuts down on the main thread
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  std::unique_ptr<forecast::Backend> backend;
+  if (simulated) {
+    backend = std::make_unique<forecast::SimBackend>();
+  } else {
+    backend = std::make_unique<forecast::ClBackend>(get_devices().front());
+  }
+  forecast::Scheduler scheduler(std::move(backend));
+  for (const auto& bitstream : bitstreams) {
+    scheduler.add_config(bitstream);
+  }
+  scheduler.enable_reordering();
+
+  {
+    forecast::SchedulerDaemon daemon(scheduler, path);
+    int                       signal = 0;
+    sigwait(&signals, &signal);
+    info("Shutting down on signal {}", signal);
+  }
+  return 0;
+}
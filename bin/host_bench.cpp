@@ -0,0 +1,17 @@
+#include <log.h>
+#include "spdlog/cfg/argv.h"
+#include <benchmark/benchmark.h>
+
+#include <benchmarks/host.h>
+#include <benchmarks/simulated.h>
+
+// Host overhead of the runtime on a null or simulated device, runs on any
+// machine without an FPGA or bitstreams
+int main(int argc, char** argv)
+{
+  spdlog::set_pattern("[%H:%M:%S] [%^%L%$] [%t] %v");
+  spdlog::cfg::load_argv_levels(argc, argv);
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -8,11 +8,95 @@
 #include <benchmarks/reconfigure.h>
 #include <benchmarks/forecast.h>
 #include <benchmarks/fft.h>
+#include <benchmarks/harness.h>
+#include <benchmarks/simulated.h>
+#include <forecast/autotune.h>
+#include <forecast/calibration.h>
+#include <forecast/tracer.h>
+
+#include <cstring>
+
+// Benchmarks that measure the roofline of the bitstreams and the link
+constexpr char calibration_filter[] = "DGEMM|VectorTriad|Bandwidth/";
+
+// Remove <flag><value> from argv and return the value, if any
+std::string take_flag(int* argc, char** argv, const char* flag)
+{
+  const auto  length = std::strlen(flag);
+  std::string value;
+  int         out = 0;
+  for (int i = 0; i < *argc; i++) {
+    if (std::strncmp(argv[i], flag, length) == 0) {
+      value = argv[i] + length;
+    } else {
+      argv[out++] = argv[i];
+    }
+  }
+  *argc = out;
+  return value;
+}
+
+bool has_filter(int argc, char** argv)
+{
+  return std::any_of(argv, argv + argc, [](const char* arg) {
+    return std::strncmp(arg, "--benchmark_filter", 18) == 0;
+  });
+}
+
+// Value of --benchmark_filter=, empty if all benchmarks run
+std::string benchmark_filter(int argc, char** argv)
+{
+  constexpr char flag[] = "--benchmark_filter=";
+  std::string    filter;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], flag, sizeof(flag) - 1) == 0) {
+      filter = argv[i] + sizeof(flag) - 1;
+    }
+  }
+  return filter;
+}
 
 int main(int argc, char **argv) {
   std::srand(std::time(0));
   spdlog::set_pattern("[%H:%M:%S] [%^%L%$] [%t] %v");
   spdlog::cfg::load_argv_levels(argc, argv);
+  const auto calibrate = take_flag(&argc, argv, "--calibrate=");
+  const auto trace     = take_flag(&argc, argv, "--trace=");
+  const auto tune      = take_flag(&argc, argv, "--tune=");
+  const auto record    = take_flag(&argc, argv, "--record=");
+  const auto compare   = take_flag(&argc, argv, "--compare=");
+  const auto filter    = benchmark_filter(argc, argv);
   benchmark::Initialize(&argc, argv);
-  benchmark::RunSpecifiedBenchmarks();
+  if (!trace.empty()) {
+    forecast::tracer().enable();
+  }
+  if (!tune.empty()) {
+    forecast::autotuner().enable(tune);
+  }
+
+  bool ok = true;
+  if (!record.empty() || !compare.empty()) {
+    // Repeated until the confidence intervals are tight
+    const auto current = run_harness(filter);
+    if (!compare.empty()) {
+      ok = compare_baseline(read_baseline(compare), current) == 0;
+    }
+    if (!record.empty()) {
+      ok = write_baseline(record, current) && ok;
+    }
+  } else if (calibrate.empty()) {
+    benchmark::RunSpecifiedBenchmarks();
+  } else {
+    forecast::calibration().enable();
+    if (has_filter(argc, argv)) {
+      benchmark::RunSpecifiedBenchmarks();
+    } else {
+      benchmark::RunSpecifiedBenchmarks(calibration_filter);
+    }
+    ok = forecast::calibration().write(calibrate);
+  }
+  if (!trace.empty()) {
+    ok = forecast::tracer().write(trace) && ok;
+  }
+  return ok ? 0 : 1;
 }
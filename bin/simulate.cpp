@@ -0,0 +1,66 @@
+#include <log.h>
+#include "spdlog/cfg/argv.h"
+
+#include <forecast/simulator.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+// Replay a scheduler trace through the scheduler on a simulated device:
+//
+//   simulate [logs/scheduler.csv] [--reconfiguration=<seconds>]
+//            [--speedup=<factor>]
+//
+// Without a trace a synthetic matrix multiplication workload is replayed.
+// The replay runs speedup times as fast as real time and logs its own
+// trace to logs/simulator.csv.
+int main(int argc, char** argv)
+{
+  spdlog::set_pattern("[%H:%M:%S] [%^%L%$] [%t] %v");
+  spdlog::cfg::load_argv_levels(argc, argv);
+
+  constexpr char flag[]          = "--reconfiguration=";
+  constexpr char speedup_flag[]  = "--speedup=";
+  double         reconfiguration = 1.5;
+  double         speedup         = 1000;
+  std::string    path;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], flag, sizeof(flag) - 1) == 0) {
+      reconfiguration = std::stod(argv[i] + sizeof(flag) - 1);
+    } else if (
+        std::strncmp(argv[i], speedup_flag, sizeof(speedup_flag) - 1) ==
+        0) {
+      speedup = std::stod(argv[i] + sizeof(speedup_flag) - 1);
+    } else if (std::strncmp(argv[i], "SPDLOG", 6) != 0) {
+      path = argv[i];
+    }
+  }
+
+  forecast::Trace tasks;
+  if (path.empty()) {
+    constexpr std::size_t size = 4096 * 4096;
+    tasks                      = forecast::synthetic_trace(
+        {{"mmult_f_d", "matrixMult", size, 0.5},
+         {"mmult_f_d", "matrixMultD", size, 0.2},
+         {"mmult_f_d2", "matrixMultD", size, 0.3}},
+        10000,
+        0.5);
+  } else {
+    tasks = forecast::read_trace(path);
+  }
+
+  const auto         start = std::chrono::steady_clock::now();
+  forecast::Simulator simulator(reconfiguration, speedup);
+  const auto         report = simulator.run(tasks);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  info("{}", report);
+  info(
+      "Simulated {}s in {}s ({}x real time)",
+      report.makespan,
+      elapsed.count(),
+      report.makespan / elapsed.count());
+  return 0;
+}
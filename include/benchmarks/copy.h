@@ -2,21 +2,29 @@
 
 #include <benchmark/benchmark.h>
 #include <benchmarks/fixtures.h>
+#include <forecast/calibration.h>
+#include <forecast/numa.h>
 #include <log.h>
 #include <util.h>
 
 // Benchmarks for copying data from/to the FPGA
 BENCHMARK_DEFINE_F(BasicKernelFixture, Bandwidth)(benchmark::State& state)
 {
-  using value_t                 = double;
-  auto&                ctx      = clstate.ctx;
-  auto&                queue    = clstate.queue;
-  size_t               buf_size = state.range(0) * 1024 * 1024;
-  std::vector<value_t> host_buf(buf_size, value_t{1});
+  using value_t                          = double;
+  auto&                         ctx      = clstate.ctx;
+  auto&                         queue    = clstate.queue;
+  size_t                        buf_size = state.range(0) * 1024 * 1024;
+  forecast::HostVector<value_t> host_buf(
+      buf_size,
+      value_t{1},
+      forecast::NumaAllocator<value_t>(
+          forecast::device_numa_node(clstate.devices.front())));
   cl::Buffer buf(ctx, CL_MEM_READ_WRITE, buf_size * sizeof(value_t));
 
+  std::chrono::duration<double> copy_duration{0};
   for (auto _ : state) {
     cl::Event copy_event;
+    auto start = std::chrono::high_resolution_clock::now();
     queue.enqueueWriteBuffer(
         buf,
         CL_TRUE,
@@ -26,10 +34,49 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, Bandwidth)(benchmark::State& state)
         NULL,
         &copy_event);
     copy_event.wait();
+    copy_duration += std::chrono::high_resolution_clock::now() - start;
+  }
+
+  forecast::calibration().record_transfer(
+      buf_size * sizeof(value_t),
+      copy_duration.count() / state.iterations());
+
+  state.SetBytesProcessed(
+      size_t(state.iterations()) * buf_size * sizeof(value_t));
+}
+
+// Writes from a host buffer on the board's NUMA node (remote:0) and from
+// one on another node (remote:1), the copying thread runs on the board's
+// node in both cases
+BENCHMARK_DEFINE_F(BasicKernelFixture, BandwidthNuma)
+(benchmark::State& state)
+{
+  using value_t = double;
+  if (forecast::numa_node_count() < 2) {
+    state.SkipWithError("Requires a host with two NUMA nodes");
+    return;
+  }
+  const auto local =
+      std::max(0, forecast::device_numa_node(clstate.devices.front()));
+  const auto node = state.range(1) ? (local + 1) % forecast::numa_node_count()
+                                   : local;
+  forecast::ScopedPin pin(local);
+
+  auto&        ctx      = clstate.ctx;
+  auto&        queue    = clstate.queue;
+  const size_t buf_size = state.range(0) * 1024 * 1024;
+  forecast::HostVector<value_t> host_buf(
+      buf_size, value_t{1}, forecast::NumaAllocator<value_t>(node));
+  cl::Buffer buf(ctx, CL_MEM_READ_WRITE, buf_size * sizeof(value_t));
+
+  for (auto _ : state) {
+    cl_ok(queue.enqueueWriteBuffer(
+        buf, CL_TRUE, 0, buf_size * sizeof(value_t), host_buf.data()));
   }
 
   state.SetBytesProcessed(
       size_t(state.iterations()) * buf_size * sizeof(value_t));
+  state.counters["node"] = node;
 }
 
 // Test how well reconfiguration and copying can be overlapped
@@ -84,6 +131,10 @@ BENCHMARK_REGISTER_F(BasicKernelFixture, Bandwidth)
     ->RangeMultiplier(2)
     ->Range(1, 2048)
     ->Unit(benchmark::kMillisecond);
+BENCHMARK_REGISTER_F(BasicKernelFixture, BandwidthNuma)
+    ->ArgsProduct({{16, 256}, {0, 1}})
+    ->ArgNames({"MiB", "remote"})
+    ->Unit(benchmark::kMillisecond);
 BENCHMARK_REGISTER_F(BasicKernelFixture, ReconfigureCopyOverlap)
     ->RangeMultiplier(2)
     ->Range(1, 2048)
@@ -7,6 +7,12 @@
 #include <cl_error.h>
 #include <forecast/queue.h>
 
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <thread>
+#include <vector>
+
 struct double2 {
   double x;
   double y;
@@ -18,10 +24,16 @@ struct float2 {
 };
 
 static int coord(int iteration, int i);
-void fourier_transform_gold(bool inverse, const int lognr_points, double2 *data);
-void fourier_stage(int lognr_points, double2 *data);
+double fft_min_snr(
+    bool inverse, double2* verify, const float2* out, size_t iterations);
+
+constexpr int ilog2(int v)
+{
+  return v > 1 ? 1 + ilog2(v / 2) : 0;
+}
 
 constexpr int N              = (1 << 14);  // must match .cl file
+constexpr int LOG_N          = ilog2(N);
 
 BENCHMARK_DEFINE_F(BasicKernelFixture, FFT1D)(benchmark::State& state)
 {
@@ -92,28 +104,8 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, FFT1D)(benchmark::State& state)
                        fft_iterations * state.iterations();
 
   // Pick randomly a few iterations and check SNR
-  double fpga_snr = 200;
-  for (size_t i = 0; i < fft_iterations; i+= rand() % 20 + 1) {
-    fourier_transform_gold(inverse, 12, h_verify + coord(i, 0));
-    double mag_sum = 0;
-    double noise_sum = 0;
-    for (int j = 0; j < N; j++) {
-      double magnitude =
-          (double)h_verify[coord(i, j)].x * (double)h_verify[coord(i, j)].x +
-          (double)h_verify[coord(i, j)].y * (double)h_verify[coord(i, j)].y;
-      double noise =
-          (h_verify[coord(i, j)].x - (double)h_outData[coord(i, j)].x) *
-              (h_verify[coord(i, j)].x - (double)h_outData[coord(i, j)].x) +
-          (h_verify[coord(i, j)].y - (double)h_outData[coord(i, j)].y) *
-              (h_verify[coord(i, j)].y - (double)h_outData[coord(i, j)].y);
-
-      mag_sum += magnitude;
-      noise_sum += noise;
-    }
-    double db = 10 * log(mag_sum / noise_sum) / log(10.0);
-    // find minimum SNR across all iterations
-    if (db < fpga_snr) fpga_snr = db;
-  }
+  const double fpga_snr =
+      fft_min_snr(inverse, h_verify, h_outData, fft_iterations);
   if(fpga_snr <= 125) {
     state.SkipWithError("Validation failed, SNR too high.");
   } else {
@@ -123,63 +115,126 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, FFT1D)(benchmark::State& state)
       benchmark::Counter(gflop, benchmark::Counter::kIsRate);
 }
 
-void fourier_transform_gold(bool inverse, const int lognr_points, double2 *data) {
-   const int nr_points = 1 << lognr_points;
-
-   // The inverse requires swapping the real and imaginary component
-   
-   if (inverse) {
-      for (int i = 0; i < nr_points; i++) {
-         double tmp = data[i].x;
-         data[i].x = data[i].y;
-         data[i].y = tmp;;
+/**
+ * Iterative radix-2 reference FFT in double precision.
+ *
+ * Decimation in frequency takes its input in natural order and leaves the
+ * output in bit-reversed order, which is the order the fft1d kernel
+ * produces. The twiddle factors of all stages are precomputed, stage by
+ * stage, so the butterfly loop reads them contiguously and vectorizes.
+ */
+class ReferenceFFT {
+public:
+  explicit ReferenceFFT(int lognr_points)
+    : _nr_points(std::size_t{1} << lognr_points)
+    , _twiddle_re(_nr_points)
+    , _twiddle_im(_nr_points)
+  {
+    // Stage with half size h stores exp(-2 pi i k / 2h) at [n - 2h + k]
+    for (std::size_t h = _nr_points / 2; h >= 1; h /= 2) {
+      const auto offset = _nr_points - 2 * h;
+      for (std::size_t k = 0; k < h; k++) {
+        _twiddle_re[offset + k] = std::cos(M_PI * k / h);
+        _twiddle_im[offset + k] = -std::sin(M_PI * k / h);
       }
-   }
-   // Do a FT recursively
-   fourier_stage(lognr_points, data);
-
-   // The inverse requires swapping the real and imaginary component
-   if (inverse) {
-      for (int i = 0; i < nr_points; i++) {
-         double tmp = data[i].x;
-         data[i].x = data[i].y;
-         data[i].y = tmp;;
-      }
-   }
-
-   // Do the bit reversal
-
-   double2 *temp = (double2 *)alloca(sizeof(double2) * nr_points);
-   for (int i = 0; i < nr_points; i++) temp[i] = data[i];
-   for (int i = 0; i < nr_points; i++) {
-      int fwd = i;
-      int bit_rev = 0;
-      for (int j = 0; j < lognr_points; j++) {
-         bit_rev <<= 1;
-         bit_rev |= fwd & 1;
-         fwd >>= 1;
+    }
+  }
+
+  void operator()(bool inverse, double2* data) const
+  {
+    // The inverse requires swapping the real and imaginary component
+    if (inverse) swap_components(data);
+
+    for (std::size_t h = _nr_points / 2; h >= 1; h /= 2) {
+      const double* w_re = _twiddle_re.data() + _nr_points - 2 * h;
+      const double* w_im = _twiddle_im.data() + _nr_points - 2 * h;
+      for (std::size_t start = 0; start < _nr_points; start += 2 * h) {
+        double2* a = data + start;
+        double2* b = data + start + h;
+#pragma GCC ivdep
+        for (std::size_t k = 0; k < h; k++) {
+          const double d_re = a[k].x - b[k].x;
+          const double d_im = a[k].y - b[k].y;
+          a[k].x += b[k].x;
+          a[k].y += b[k].y;
+          b[k].x = d_re * w_re[k] - d_im * w_im[k];
+          b[k].y = d_re * w_im[k] + d_im * w_re[k];
+        }
       }
-      data[i] = temp[bit_rev];
-   }
+    }
+
+    if (inverse) swap_components(data);
+  }
+
+private:
+  void swap_components(double2* data) const
+  {
+    for (std::size_t i = 0; i < _nr_points; i++) {
+      std::swap(data[i].x, data[i].y);
+    }
+  }
+
+  std::size_t         _nr_points;
+  std::vector<double> _twiddle_re;
+  std::vector<double> _twiddle_im;
+};
+
+void fourier_transform_gold(bool inverse, double2* data)
+{
+  static const ReferenceFFT fft(LOG_N);
+  fft(inverse, data);
+}
+
+double fft_snr(const double2* verify, const float2* out)
+{
+  double mag_sum   = 0;
+  double noise_sum = 0;
+  for (int j = 0; j < N; j++) {
+    const double d_re = verify[j].x - (double)out[j].x;
+    const double d_im = verify[j].y - (double)out[j].y;
+    mag_sum += verify[j].x * verify[j].x + verify[j].y * verify[j].y;
+    noise_sum += d_re * d_re + d_im * d_im;
+  }
+  return 10 * log(mag_sum / noise_sum) / log(10.0);
 }
 
-void fourier_stage(int lognr_points, double2 *data) {
-   int nr_points = 1 << lognr_points;
-   if (nr_points == 1) return;
-   double2 *half1 = (double2 *)alloca(sizeof(double2) * nr_points / 2);
-   double2 *half2 = (double2 *)alloca(sizeof(double2) * nr_points / 2);
-   for (int i = 0; i < nr_points / 2; i++) {
-      half1[i] = data[2 * i];
-      half2[i] = data[2 * i + 1];
-   }
-   fourier_stage(lognr_points - 1, half1);
-   fourier_stage(lognr_points - 1, half2);
-   for (int i = 0; i < nr_points / 2; i++) {
-      data[i].x = half1[i].x + cos (2 * M_PI * i / nr_points) * half2[i].x + sin (2 * M_PI * i / nr_points) * half2[i].y;
-      data[i].y = half1[i].y - sin (2 * M_PI * i / nr_points) * half2[i].x + cos (2 * M_PI * i / nr_points) * half2[i].y;
-      data[i + nr_points / 2].x = half1[i].x - cos (2 * M_PI * i / nr_points) * half2[i].x - sin (2 * M_PI * i / nr_points) * half2[i].y;
-      data[i + nr_points / 2].y = half1[i].y + sin (2 * M_PI * i / nr_points) * half2[i].x - cos (2 * M_PI * i / nr_points) * half2[i].y;
-   }
+/**
+ * Transform a random sample of the iterations on the host and return the
+ * minimum signal to noise ratio of the device output. The samples are
+ * distributed over all hardware threads.
+ */
+double fft_min_snr(
+    bool inverse, double2* verify, const float2* out, size_t iterations)
+{
+  std::vector<size_t> samples;
+  for (size_t i = 0; i < iterations; i += rand() % 20 + 1) {
+    samples.push_back(i);
+  }
+
+  const size_t hw_threads = std::thread::hardware_concurrency();
+  const size_t threads =
+      std::max<size_t>(1, std::min(hw_threads, samples.size()));
+  std::atomic<size_t>              next{0};
+  std::vector<std::future<double>> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.push_back(std::async(std::launch::async, [&]() {
+      double min_snr = 200;
+      for (size_t s = next++; s < samples.size(); s = next++) {
+        const auto i = samples[s];
+        fourier_transform_gold(inverse, verify + coord(i, 0));
+        min_snr = std::min(
+            min_snr, fft_snr(verify + coord(i, 0), out + coord(i, 0)));
+      }
+      return min_snr;
+    }));
+  }
+
+  // find minimum SNR across all iterations
+  double fpga_snr = 200;
+  for (auto& worker : workers) {
+    fpga_snr = std::min(fpga_snr, worker.get());
+  }
+  return fpga_snr;
 }
 
 int coord(int iteration, int i) {
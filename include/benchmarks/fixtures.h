@@ -1,8 +1,12 @@
 #pragma once
 
 #include <benchmark/benchmark.h>
+#include <benchmarks/validation.h>
 #include <forecast/configuration.h>
+#include <forecast/numa.h>
+#include <forecast/program_cache.h>
 #include <forecast/scheduler.h>
+#include <forecast/workload.h>
 #include <log.h>
 #include <util.h>
 #include <unordered_map>
@@ -35,8 +39,7 @@ public:
     if(programs.count(prog_name)) {
       return programs[prog_name];
     }
-    cl::Program prg(ctx, devices, binary(prog_name).cl_binaries());
-    cl_ok(prg.build()); //no op
+    auto prg = forecast::build_program(ctx, devices, prog_name);
     programs.insert(std::make_pair(prog_name, prg));
     return programs[prog_name];
   }
@@ -46,7 +49,7 @@ public:
       return binaries[bin_name];
     }
     std::stringstream file;
-    file << "../kernels/" << bin_name << ".aocx";
+    file << forecast::kernels_path() << bin_name << ".aocx";
     Binary binary(file.str().c_str());
     binaries.insert(std::make_pair(bin_name, binary));
     return binaries[bin_name];
@@ -115,41 +118,68 @@ public:
   {
   }
 
+  // Every benchmark run reports its own metrics
+  void SetUp(const ::benchmark::State&) override
+  {
+    scheduler.metrics().reset();
+  }
+
   forecast::Scheduler scheduler;
 };
 
+// Publish the scheduler metrics of a run as counters, times in seconds
+void publish_metrics(
+    benchmark::State& state, const forecast::MetricsSnapshot& metrics)
+{
+  for (const auto& kernel : metrics.kernels) {
+    const auto& k      = kernel.second;
+    const auto  prefix = kernel.first + "_";
+    state.counters[prefix + "completed"] = benchmark::Counter(k.completed);
+    state.counters[prefix + "wait_p99"] = k.queue_wait.percentile(0.99) * 1e-9;
+    state.counters[prefix + "device_p50"] = k.device.percentile(0.5) * 1e-9;
+    state.counters[prefix + "device_p99"] = k.device.percentile(0.99) * 1e-9;
+    state.counters[prefix + "callback_p99"] =
+        k.callback.percentile(0.99) * 1e-9;
+    state.counters[prefix + "model_error"] =
+        k.model_error.percentile(0.5) * 1e-6;
+  }
+  state.counters["reconfigurations"] =
+      benchmark::Counter(metrics.reconfigurations());
+}
+
 class RandomTasks {
 public:
+  RandomTasks(unsigned seed = std::rand())
+    : _rng(seed)
+  {
+  }
+
   void add_kernel(float prob, forecast::Task&& task, std::function<forecast::TaskDims()> size_gen)
   {
     _tasks.emplace_back(std::move(task));
-    float init = _offsets.size() > 0 ? _offsets.back() : 0;
-    _offsets.emplace_back(init + prob);
+    _weights.push_back(prob);
+    _table = forecast::AliasTable(_weights);
     _size_gens.emplace_back(size_gen);
   }
 
   forecast::Task next_task() {
-    assert(_offsets.size() > 0);
-    assert(
-        std::abs(_offsets.back() - 1.0f) <=
-        std::numeric_limits<float>::epsilon());
-
-    float random =
-        static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX);
-    auto  selected_it =
-        std::find_if(_offsets.begin(), _offsets.end(), [random](auto offset) {
-          return offset > random;
-        });
-    auto task_index = std::distance(_offsets.begin(), selected_it);
-    auto task = forecast::Task{_tasks[task_index]};
-    task.set_dims(_size_gens[task_index]());
+    assert(_table.size() > 0);
+
+    const auto  task_index = _table(_rng);
+    const auto& prototype  = _tasks[task_index];
+    forecast::Task task{
+        prototype.interned_name(),
+        prototype.kernel_gen(),
+        _size_gens[task_index]()};
     debug("Generated task: {}", task);
     return task;
   }
 
 private:
+  forecast::Rng                         _rng;
   std::vector<forecast::Task>           _tasks;
-  std::vector<float>                    _offsets;
+  std::vector<double>                   _weights;
+  forecast::AliasTable                  _table;
   std::vector<std::function<forecast::TaskDims()>>  _size_gens;
 };
 
@@ -167,7 +197,11 @@ struct Buffer {
 
   void fill(const cl::CommandQueue& queue, T init) const
   {
-    std::vector<T> host_buf(size, init);
+    forecast::HostVector<T> host_buf(
+        size,
+        init,
+        forecast::NumaAllocator<T>(forecast::device_numa_node(
+            queue.getInfo<CL_QUEUE_DEVICE>())));
     // Note: we should be able to use enqueueFillBuffer here, but the
     // implementation segfauls. See Intel KBD article about enqueueFillBuffer.
     cl_ok(queue.enqueueWriteBuffer(
@@ -175,11 +209,9 @@ struct Buffer {
   }
 
   template <typename Func>
-  bool validate(const cl::CommandQueue& queue, Func&& func) const
+  ValidationResult validate(const cl::CommandQueue& queue, Func&& func) const
   {
-    std::vector<T> host_copy(size);
-    cl_ok(cl::copy(queue, buf, host_copy.begin(), host_copy.end()));
-    return std::all_of(host_copy.begin(), host_copy.end(), func);
+    return validate_buffer<T>(queue, buf, size, func);
   }
 
   size_t     size;
@@ -30,22 +30,65 @@ BENCHMARK_DEFINE_F(ForecastFixture, Triad)(benchmark::State& state)
   };
 
 
+  // Single work-item kernel, the model needs to know the size
+  auto triad_task = [&create_kernel, buf_size](const std::string& name) {
+    forecast::Task task(name, create_kernel);
+    task.set_problem_size(buf_size);
+    return task;
+  };
+
   for (auto _ : state) {
     for(int i = 0; i < 10; i++) {
-      scheduler.add_task(forecast::Task("vector_triad1", create_kernel));
-      scheduler.add_task(forecast::Task("vector_triad2", create_kernel));
+      scheduler.add_task(triad_task("vector_triad1"));
+      scheduler.add_task(triad_task("vector_triad2"));
     }
     scheduler.wait();
     warn("done");
   }
 
 
-  const bool valid = buffers[0].validate(
+  const auto valid = buffers[0].validate(
       queue, [](const auto& val) { return val == 2 * 3 + 4; });
+  report_validation(state, valid);
+  publish_metrics(state, scheduler.metrics().snapshot());
+}
+
+// The NDRange triad leaves its local size to the autotuner, run with
+// --tune=<path> to search for it
+BENCHMARK_DEFINE_F(ForecastFixture, TriadNDRange)(benchmark::State& state)
+{
+  using value_t   = float;
+  size_t buf_size = state.range(0);
+  auto& queue = clstate.queue;
+  auto& ctx = clstate.ctx;
 
-  if(!valid) {
-    state.SkipWithError("Validation failed.");
+  Buffers<4, value_t> buffers(ctx, buf_size);
+  buffers.fill_all(queue, {0, 2, 3, 4});
+
+  scheduler.add_config("vector_triad_n1");
+
+  forecast::KernelGen create_kernel = [&buffers](const cl::Program &prg, const std::string &kernel_name) {
+    int err = 0;
+    cl::Kernel kernel(prg, kernel_name.c_str(), &err);
+    cl_ok(err);
+    set_bufs_as_args(kernel, buffers);
+    return kernel;
+  };
+
+  for (auto _ : state) {
+    for(int i = 0; i < 10; i++) {
+      scheduler.add_task(forecast::Task(
+          "vector_triad_nd",
+          create_kernel,
+          forecast::TaskDims(cl::NDRange(buf_size))));
+    }
+    scheduler.wait();
   }
+
+  const auto valid = buffers[0].validate(
+      queue, [](const auto& val) { return val == 2 * 3 + 4; });
+  report_validation(state, valid);
+  publish_metrics(state, scheduler.metrics().snapshot());
 }
 
 BENCHMARK_DEFINE_F(ForecastFixture, Mmult)(benchmark::State& state)
@@ -91,11 +134,10 @@ BENCHMARK_DEFINE_F(ForecastFixture, Mmult)(benchmark::State& state)
   state.counters["FLOPs"] =
       benchmark::Counter(flops, benchmark::Counter::kIsRate);
 
-  bool valid = buffers[0].validate(
+  const auto valid = buffers[0].validate(
       queue, [N](const auto& val) { return val == 6 * N; });
-  if (!valid) {
-    state.SkipWithError("Validation failed.");
-  }
+  report_validation(state, valid);
+  publish_metrics(state, scheduler.metrics().snapshot());
 }
 
 BENCHMARK_DEFINE_F(ForecastFixture, MmultRandom)(benchmark::State& state)
@@ -157,11 +199,10 @@ BENCHMARK_DEFINE_F(ForecastFixture, MmultRandom)(benchmark::State& state)
   state.counters["FLOPs"] =
       benchmark::Counter(flops, benchmark::Counter::kIsRate);
 
-  bool valid = f_buffers[0].validate(
+  const auto valid = f_buffers[0].validate(
       queue, [N](const auto& val) { return val == 6 * N; });
-  if (!valid) {
-    state.SkipWithError("Validation failed.");
-  }
+  report_validation(state, valid);
+  publish_metrics(state, scheduler.metrics().snapshot());
 }
 
 BENCHMARK_DEFINE_F(ForecastFixture, FFT1D)(benchmark::State& state)
@@ -238,28 +279,8 @@ BENCHMARK_DEFINE_F(ForecastFixture, FFT1D)(benchmark::State& state)
                        fft_iterations * state.iterations();
 
   // Pick randomly a few iterations and check SNR
-  double fpga_snr = 200;
-  for (size_t i = 0; i < fft_iterations; i+= rand() % 20 + 1) {
-    fourier_transform_gold(inverse, 12, h_verify + coord(i, 0));
-    double mag_sum = 0;
-    double noise_sum = 0;
-    for (int j = 0; j < N; j++) {
-      double magnitude =
-          (double)h_verify[coord(i, j)].x * (double)h_verify[coord(i, j)].x +
-          (double)h_verify[coord(i, j)].y * (double)h_verify[coord(i, j)].y;
-      double noise =
-          (h_verify[coord(i, j)].x - (double)h_outData[coord(i, j)].x) *
-              (h_verify[coord(i, j)].x - (double)h_outData[coord(i, j)].x) +
-          (h_verify[coord(i, j)].y - (double)h_outData[coord(i, j)].y) *
-              (h_verify[coord(i, j)].y - (double)h_outData[coord(i, j)].y);
-
-      mag_sum += magnitude;
-      noise_sum += noise;
-    }
-    double db = 10 * log(mag_sum / noise_sum) / log(10.0);
-    // find minimum SNR across all iterations
-    if (db < fpga_snr) fpga_snr = db;
-  }
+  const double fpga_snr =
+      fft_min_snr(inverse, h_verify, h_outData, fft_iterations);
   if(fpga_snr <= 125) {
     state.SkipWithError("Validation failed, SNR too high.");
   } else {
@@ -267,12 +288,18 @@ BENCHMARK_DEFINE_F(ForecastFixture, FFT1D)(benchmark::State& state)
   }
   state.counters["FLOPs"] =
       benchmark::Counter(gflop, benchmark::Counter::kIsRate);
+  publish_metrics(state, scheduler.metrics().snapshot());
 }
 
 BENCHMARK_REGISTER_F(ForecastFixture, Triad)
     ->RangeMultiplier(2)
     ->Range(1 << 5, 1 << 22)
     ->Unit(benchmark::kMillisecond);
+BENCHMARK_REGISTER_F(ForecastFixture, TriadNDRange)
+    ->RangeMultiplier(4)
+    ->Range(1 << 10, 1 << 22)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
 BENCHMARK_REGISTER_F(ForecastFixture, Mmult)
     ->RangeMultiplier(2)
     ->Range(64, 64 << 7)
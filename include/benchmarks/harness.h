@@ -0,0 +1,566 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <log.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Runs the benchmarks repeatedly and compares them to a stored baseline,
+// see run_all --record= and --compare=
+
+constexpr int baseline_version = 1;
+
+struct HarnessPolicy {
+  // Samples per benchmark, one per pass over it
+  std::size_t min_samples = 5;
+  std::size_t max_samples = 30;
+  // Half width of the 95% confidence interval relative to the mean
+  double precision = 0.02;
+  // Leading samples that may be dropped as warmup, e.g. the first run
+  // after a reconfiguration
+  std::size_t max_warmup = 3;
+  // Samples further than this many scaled MADs from the median are outliers
+  double outlier_mads = 3.5;
+  // Changes below this are never reported, however significant
+  double min_change = 0.01;
+};
+
+// Two-sided 95% quantile of Student's t distribution
+double t_critical(double df)
+{
+  static const double table[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  constexpr std::size_t size = sizeof(table) / sizeof(table[0]);
+  if (df < 1) {
+    return table[0];
+  }
+  const auto i = static_cast<std::size_t>(df);
+  return i <= size ? table[i - 1] : 1.96 + 2.4 / df;
+}
+
+double median(std::vector<double> values)
+{
+  if (values.empty()) {
+    return 0;
+  }
+  const auto mid = values.begin() + values.size() / 2;
+  std::nth_element(values.begin(), mid, values.end());
+  if (values.size() % 2) {
+    return *mid;
+  }
+  return (*mid + *std::max_element(values.begin(), mid)) / 2;
+}
+
+// Median absolute deviation, scaled to the standard deviation of a normal
+double scaled_mad(const std::vector<double>& values, double center)
+{
+  std::vector<double> deviations;
+  for (auto v : values) {
+    deviations.push_back(std::abs(v - center));
+  }
+  return 1.4826 * median(deviations);
+}
+
+// Summary of one metric of one benchmark
+struct Estimate {
+  double      mean   = 0;
+  double      stddev = 0;
+  std::size_t samples  = 0;
+  std::size_t warmup   = 0;
+  std::size_t outliers = 0;
+  bool        higher_is_better = false;
+  // Decides convergence and regressions, other metrics are only reported
+  bool        gated = false;
+
+  // Relative half width of the 95% confidence interval
+  double precision() const
+  {
+    if (samples < 2) {
+      return std::numeric_limits<double>::infinity();
+    }
+    const auto half = t_critical(samples - 1) * stddev / std::sqrt(samples);
+    return mean != 0 ? std::abs(half / mean) : (stddev == 0 ? 0 : half);
+  }
+};
+
+/**
+ * Samples of one metric in the order they were taken. Leading samples that
+ * are outliers against the rest are warmup, outliers among the rest are
+ * dropped before the mean and deviation are estimated.
+ */
+struct Samples {
+  Estimate estimate(const HarnessPolicy& policy) const
+  {
+    Estimate e;
+    e.higher_is_better = higher_is_better;
+    e.gated            = gated;
+    auto first         = values.begin();
+    while (e.warmup < policy.max_warmup &&
+           std::distance(first, values.end()) >
+               static_cast<long>(policy.min_samples)) {
+      const std::vector<double> rest(first + 1, values.end());
+      const auto                center = median(rest);
+      const auto                mad    = scaled_mad(rest, center);
+      if (std::abs(*first - center) <= policy.outlier_mads * mad ||
+          mad == 0) {
+        break;
+      }
+      ++first;
+      e.warmup++;
+    }
+
+    std::vector<double> kept(first, values.end());
+    const auto          center = median(kept);
+    const auto          mad    = scaled_mad(kept, center);
+    if (mad > 0) {
+      const auto end = std::remove_if(
+          kept.begin(), kept.end(), [&](double v) {
+            return std::abs(v - center) > policy.outlier_mads * mad;
+          });
+      e.outliers = std::distance(end, kept.end());
+      kept.erase(end, kept.end());
+    }
+
+    e.samples = kept.size();
+    for (auto v : kept) {
+      e.mean += v / kept.size();
+    }
+    for (auto v : kept) {
+      e.stddev += (v - e.mean) * (v - e.mean);
+    }
+    e.stddev = kept.size() > 1 ? std::sqrt(e.stddev / (kept.size() - 1)) : 0;
+    return e;
+  }
+
+  std::vector<double> values;
+  bool                higher_is_better = false;
+  bool                gated            = false;
+};
+
+// Benchmark -> metric -> estimate
+using Baseline = std::map<std::string, std::map<std::string, Estimate>>;
+
+// Counters that are times, lower is better
+const std::set<std::string>& time_counters()
+{
+  static const std::set<std::string> counters = {"triad_Time"};
+  return counters;
+}
+
+/**
+ * Keeps every run of the benchmarks as a sample of its real time and its
+ * counters. The real time, rates such as FLOPs and bytes_per_second, which
+ * are better when higher, and the time_counters() are gated. Other
+ * counters, e.g. miss_rate, batch or completed, may be mostly zero,
+ * discrete or better either way; they are only reported.
+ */
+class SampleReporter : public benchmark::BenchmarkReporter {
+public:
+  bool ReportContext(const Context&) override
+  {
+    return true;
+  }
+
+  void ReportRuns(const std::vector<Run>& runs) override
+  {
+    for (const auto& run : runs) {
+      if (run.run_type != Run::RT_Iteration) {
+        continue;
+      }
+      const auto name = run.benchmark_name();
+      if (run.error_occurred) {
+        warn("{} failed: {}", name, run.error_message);
+        failed.insert(name);
+        continue;
+      }
+      auto& metrics   = samples[name];
+      auto& real_time = metrics["real_time"];
+      real_time.values.push_back(run.GetAdjustedRealTime());
+      real_time.gated = true;
+      for (const auto& counter : run.counters) {
+        auto& metric = metrics[counter.first];
+        metric.values.push_back(counter.second.value);
+        metric.higher_is_better =
+            counter.second.flags & benchmark::Counter::kIsRate;
+        metric.gated = metric.higher_is_better ||
+                       time_counters().count(counter.first) > 0;
+      }
+    }
+  }
+
+  std::map<std::string, std::map<std::string, Samples>> samples;
+  std::set<std::string>                                 failed;
+};
+
+// Matches exactly the benchmark of the name
+std::string exact_filter(const std::string& name)
+{
+  std::string escaped;
+  for (auto c : name) {
+    if (std::strchr("\\^$.|?*+()[]{}", c)) {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+/**
+ * Runs the benchmarks the filter selects until the confidence interval of
+ * every gated metric is within HarnessPolicy::precision, or for
+ * max_samples passes. Each pass only runs the benchmarks that have not
+ * converged yet.
+ */
+Baseline run_harness(const std::string& filter, HarnessPolicy policy = {})
+{
+  SampleReporter reporter;
+  std::set<std::string> pending;
+  for (std::size_t pass = 0; pass < policy.max_samples; pass++) {
+    std::string spec = filter;
+    if (pass > 0) {
+      spec.clear();
+      for (const auto& name : pending) {
+        spec += (spec.empty() ? "^(" : "|") + exact_filter(name);
+      }
+      spec += ")$";
+    }
+    benchmark::RunSpecifiedBenchmarks(&reporter, spec);
+    if (pass == 0) {
+      for (const auto& benchmark : reporter.samples) {
+        pending.insert(benchmark.first);
+      }
+    }
+    for (const auto& name : reporter.failed) {
+      pending.erase(name);
+    }
+
+    for (auto it = pending.begin(); it != pending.end();) {
+      const auto& metrics   = reporter.samples[*it];
+      const auto  converged = std::all_of(
+          metrics.begin(), metrics.end(), [&policy](const auto& metric) {
+            if (!metric.second.gated) {
+              return true;
+            }
+            const auto e = metric.second.estimate(policy);
+            return metric.second.values.size() >= policy.min_samples &&
+                   e.precision() <= policy.precision;
+          });
+      it = converged ? pending.erase(it) : std::next(it);
+    }
+    debug("Pass {}: {} benchmarks not converged", pass + 1, pending.size());
+    if (pending.empty()) {
+      break;
+    }
+  }
+
+  Baseline baseline;
+  for (const auto& benchmark : reporter.samples) {
+    if (reporter.failed.count(benchmark.first)) {
+      continue;
+    }
+    for (const auto& metric : benchmark.second) {
+      auto& e = baseline[benchmark.first][metric.first];
+      e       = metric.second.estimate(policy);
+      info(
+          "{} {}: {:g} ± {:.1f}% ({} samples, {} warmup, {} outliers)",
+          benchmark.first,
+          metric.first,
+          e.mean,
+          100 * e.precision(),
+          e.samples,
+          e.warmup,
+          e.outliers);
+    }
+  }
+  return baseline;
+}
+
+std::string json_escape(const std::string& s)
+{
+  std::string escaped;
+  for (auto c : s) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+bool write_baseline(const std::string& path, const Baseline& baseline)
+{
+  std::ofstream out(path);
+  if (!out) {
+    warn("Could not write the baseline to {}", path);
+    return false;
+  }
+  char host[256] = {};
+  gethostname(host, sizeof(host) - 1);
+  out.precision(17);
+  out << "{\n  \"version\": " << baseline_version << ",\n  \"host\": \""
+      << json_escape(host) << "\",\n  \"date\": " << std::time(nullptr)
+      << ",\n  \"benchmarks\": {";
+  const char* separator = "\n";
+  for (const auto& benchmark : baseline) {
+    out << separator << "    \"" << json_escape(benchmark.first) << "\": {";
+    const char* inner = "\n";
+    for (const auto& metric : benchmark.second) {
+      const auto& e = metric.second;
+      out << inner << "      \"" << json_escape(metric.first)
+          << "\": {\"mean\": " << e.mean << ", \"stddev\": " << e.stddev
+          << ", \"samples\": " << e.samples << ", \"warmup\": " << e.warmup
+          << ", \"outliers\": " << e.outliers << ", \"higher_is_better\": "
+          << (e.higher_is_better ? "true" : "false") << ", \"gated\": "
+          << (e.gated ? "true" : "false") << "}";
+      inner = ",\n";
+    }
+    out << "\n    }";
+    separator = ",\n";
+  }
+  out << "\n  }\n}\n";
+  info("Wrote the baseline of {} benchmarks to {}", baseline.size(), path);
+  return true;
+}
+
+/**
+ * Just enough JSON for the baselines write_baseline writes: objects,
+ * strings, numbers and booleans. Fails on anything else.
+ */
+class JsonReader {
+public:
+  explicit JsonReader(std::string text)
+    : _text(std::move(text))
+  {
+  }
+
+  bool ok() const
+  {
+    return _ok;
+  }
+
+  // Calls member(key) for every member of the object at the cursor
+  template <typename F>
+  void object(F&& member)
+  {
+    expect('{');
+    if (peek() == '}') {
+      _pos++;
+      return;
+    }
+    while (_ok) {
+      const auto key = string();
+      expect(':');
+      member(key);
+      if (peek() != ',') {
+        break;
+      }
+      _pos++;
+    }
+    expect('}');
+  }
+
+  std::string string()
+  {
+    expect('"');
+    std::string s;
+    while (_ok && _pos < _text.size() && _text[_pos] != '"') {
+      if (_text[_pos] == '\\') {
+        _pos++;
+      }
+      s += _text[_pos++];
+    }
+    expect('"');
+    return s;
+  }
+
+  double number()
+  {
+    peek();
+    const char* begin = _text.c_str() + _pos;
+    char*       end   = nullptr;
+    const auto  value = std::strtod(begin, &end);
+    _ok               = _ok && end != begin;
+    _pos += end - begin;
+    return value;
+  }
+
+  bool boolean()
+  {
+    const bool value = peek() == 't';
+    const auto word  = value ? "true" : "false";
+    _ok = _ok && _text.compare(_pos, std::strlen(word), word) == 0;
+    _pos += std::strlen(word);
+    return value;
+  }
+
+  void skip()
+  {
+    switch (peek()) {
+      case '{': object([this](const std::string&) { skip(); }); break;
+      case '"': string(); break;
+      case 't':
+      case 'f': boolean(); break;
+      default: number();
+    }
+  }
+
+private:
+  char peek()
+  {
+    while (_pos < _text.size() && std::isspace(_text[_pos])) {
+      _pos++;
+    }
+    return _pos < _text.size() ? _text[_pos] : '\0';
+  }
+
+  void expect(char c)
+  {
+    _ok = _ok && peek() == c;
+    _pos++;
+  }
+
+  std::string _text;
+  std::size_t _pos = 0;
+  bool        _ok  = true;
+};
+
+// Empty if the file is missing, malformed or of another version
+Baseline read_baseline(const std::string& path)
+{
+  std::ifstream in(path);
+  if (!in) {
+    warn("No baseline in {}", path);
+    return {};
+  }
+  JsonReader reader{std::string(
+      std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>())};
+  Baseline baseline;
+  int      version = 0;
+  reader.object([&](const std::string& key) {
+    if (key == "version") {
+      version = static_cast<int>(reader.number());
+    } else if (key == "benchmarks") {
+      reader.object([&](const std::string& name) {
+        reader.object([&](const std::string& metric) {
+          auto& e = baseline[name][metric];
+          reader.object([&](const std::string& field) {
+            if (field == "mean") {
+              e.mean = reader.number();
+            } else if (field == "stddev") {
+              e.stddev = reader.number();
+            } else if (field == "samples") {
+              e.samples = static_cast<std::size_t>(reader.number());
+            } else if (field == "higher_is_better") {
+              e.higher_is_better = reader.boolean();
+            } else if (field == "gated") {
+              e.gated = reader.boolean();
+            } else {
+              reader.skip();
+            }
+          });
+        });
+      });
+    } else {
+      reader.skip();
+    }
+  });
+  if (!reader.ok() || version != baseline_version) {
+    warn(
+        "Ignoring the baseline in {}: {}",
+        path,
+        reader.ok() ? "version " + std::to_string(version) : "malformed");
+    return {};
+  }
+  return baseline;
+}
+
+/**
+ * Welch's t-test of every metric both runs have. Logs significant changes
+ * and returns the number of regressions among the gated metrics of the
+ * current run.
+ */
+std::size_t compare_baseline(
+    const Baseline&      baseline,
+    const Baseline&      current,
+    const HarnessPolicy& policy = {})
+{
+  std::size_t regressions = 0, improvements = 0;
+  for (const auto& benchmark : current) {
+    const auto before = baseline.find(benchmark.first);
+    if (before == baseline.end()) {
+      info("{} is not in the baseline", benchmark.first);
+      continue;
+    }
+    for (const auto& metric : benchmark.second) {
+      const auto old = before->second.find(metric.first);
+      if (old == before->second.end()) {
+        continue;
+      }
+      const auto& a = old->second;
+      const auto& b = metric.second;
+      if (a.samples < 2 || b.samples < 2 || a.mean == 0) {
+        continue;
+      }
+      const auto va     = a.stddev * a.stddev / a.samples;
+      const auto vb     = b.stddev * b.stddev / b.samples;
+      const auto change = (b.mean - a.mean) / std::abs(a.mean);
+      bool       significant = va + vb == 0;
+      if (va + vb > 0) {
+        const auto t  = (b.mean - a.mean) / std::sqrt(va + vb);
+        const auto df = (va + vb) * (va + vb) /
+                        (va * va / (a.samples - 1) + vb * vb / (b.samples - 1));
+        significant = std::abs(t) > t_critical(df);
+      }
+      if (!significant || std::abs(change) < policy.min_change) {
+        continue;
+      }
+      if (!b.gated) {
+        info(
+            "{} {}: {:g} -> {:g} ({:+.1f}%)",
+            benchmark.first,
+            metric.first,
+            a.mean,
+            b.mean,
+            100 * change);
+      } else if ((change > 0) == b.higher_is_better) {
+        improvements++;
+        info(
+            "{} {}: {:g} -> {:g} ({:+.1f}%), improvement",
+            benchmark.first,
+            metric.first,
+            a.mean,
+            b.mean,
+            100 * change);
+      } else {
+        regressions++;
+        warn(
+            "{} {}: {:g} -> {:g} ({:+.1f}%), regression",
+            benchmark.first,
+            metric.first,
+            a.mean,
+            b.mean,
+            100 * change);
+      }
+    }
+  }
+  info(
+      "{} significant regressions, {} improvements against the baseline",
+      regressions,
+      improvements);
+  return regressions;
+}
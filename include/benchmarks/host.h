@@ -0,0 +1,137 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <benchmarks/fixtures.h>
+#include <forecast/model.h>
+#include <forecast/parameters.h>
+#include <forecast/queue.h>
+#include <forecast/sim_backend.h>
+#include <forecast/task.h>
+
+#include <thread>
+#include <vector>
+
+// Microbenchmarks of the runtime's hot host paths, see bin/host_bench.cpp.
+// They run on a NullBackend and need no FPGA.
+
+forecast::Task host_mmult(size_t N)
+{
+  return forecast::Task{
+      "matrixMult",
+      {},
+      forecast::TaskDims{cl::NDRange(N, N), cl::NDRange(64, 64)}};
+}
+
+// Offline roofline prediction of a task, threads contend for the table of
+// kernel parameters
+static void HostModelCost(benchmark::State& state)
+{
+  const forecast::Model model("mmult_f_d");
+  const auto            task = host_mmult(1024);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(model.cost(task));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Online fit over a history of measurements, constant in its length
+static void HostModelLinreg(benchmark::State& state)
+{
+  forecast::Model model("mmult_f_d");
+  const auto      task = host_mmult(1024);
+  for (int64_t i = 0; i < state.range(0); i++) {
+    forecast::Measurement m{1e-3 * (i % 64 + 1), 1e6 * (i % 64 + 1)};
+    model.add_measurement(task, m);
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(model.linreg(task));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Updating and reading the tail sketch of a size bucket, as log_task does
+// for every task
+static void HostModelTail(benchmark::State& state)
+{
+  forecast::Model model("mmult_f_d");
+  const auto      task = host_mmult(1024);
+  double          seconds = 1e-3;
+  for (auto _ : state) {
+    model.add_tail(task, 2e9, seconds);
+    benchmark::DoNotOptimize(model.tail(task, 2e9, seconds));
+    seconds = seconds * 1.1 > 2e-3 ? 1e-3 : seconds * 1.1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void HostKernelParams(benchmark::State& state)
+{
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        &forecast::kernel_params("mmult_f_d", "matrixMult"));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Tasks per second from enqueue through queue_loop to the callback, with
+// several threads enqueueing
+static void HostQueue(benchmark::State& state)
+{
+  forecast::NullBackend backend;
+  forecast::Queue       queue(backend, [](forecast::Task&) {}, "host");
+
+  const auto       threads = static_cast<size_t>(state.range(0));
+  constexpr size_t tasks   = 10000;
+  const auto*      name    = forecast::intern("matrixMult");
+  for (auto _ : state) {
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < threads; t++) {
+      producers.emplace_back([&]() {
+        for (size_t i = 0; i < tasks / threads; i++) {
+          queue.enqueue(forecast::Task(name, {}, {}));
+        }
+      });
+    }
+    for (auto& producer : producers) {
+      producer.join();
+    }
+    queue.wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * (tasks / threads) * threads);
+}
+
+// Drawing from a mix of kernels with random sizes, as the workload
+// benchmarks do
+static void HostRandomTasks(benchmark::State& state)
+{
+  RandomTasks random(42);
+  for (int64_t k = 0; k < state.range(0); k++) {
+    random.add_kernel(
+        1.0f / (k + 1),
+        forecast::Task("kernel" + std::to_string(k), {}),
+        []() {
+          return forecast::TaskDims{
+              cl::NDRange(1024, 1024), cl::NDRange(64, 64)};
+        });
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(random.next_task());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(HostModelCost)->ThreadRange(1, 8);
+BENCHMARK(HostModelLinreg)
+    ->ArgName("history")
+    ->RangeMultiplier(100)
+    ->Range(0, 1000000);
+BENCHMARK(HostModelTail);
+BENCHMARK(HostKernelParams)->ThreadRange(1, 8);
+BENCHMARK(HostQueue)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(HostRandomTasks)->ArgName("kernels")->Arg(1)->Arg(4)->Arg(16);
@@ -4,6 +4,7 @@
 #include <benchmarks/fixtures.h>
 #include <log.h>
 #include <util.h>
+#include <forecast/calibration.h>
 #include <forecast/queue.h>
 
 BENCHMARK_DEFINE_F(BasicKernelFixture, Empty)(benchmark::State& state)
@@ -29,20 +30,30 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, VectorTriad)(benchmark::State& state)
   auto vector_triad = kernel("vector_triad_n1", "vector_triad1");
 	clstate.queue.finish();
 
+  std::chrono::duration<double> triad_duration{0};
   for (auto _ : state) {
     cl::Event kernel_done;
     set_bufs_as_args(vector_triad, buffers);
     vector_triad.setArg(4, static_cast<unsigned long>(buf_size));
+    auto start = std::chrono::high_resolution_clock::now();
     clstate.queue.enqueueTask(vector_triad, NULL, &kernel_done);
     kernel_done.wait();
+    triad_duration += std::chrono::high_resolution_clock::now() - start;
   }
 
-  const bool valid = buffers[0].validate(
+  const double triads = static_cast<double>(buf_size) * state.iterations();
+  forecast::calibration().record_flops(
+      "vector_triad_n1",
+      "vector_triad1",
+      2 * triads / triad_duration.count());
+  forecast::calibration().record_bandwidth(
+      "vector_triad_n1",
+      "vector_triad1",
+      4 * sizeof(value_t) * triads / triad_duration.count());
+
+  const auto valid = buffers[0].validate(
       clstate.queue, [](const auto& val) { return val == 2 * 3 + 4; });
-
-  if(!valid) {
-    state.SkipWithError("Validation failed.");
-  }
+  report_validation(state, valid);
 }
 
 // Benchmarks for copying data from/to the FPGA
@@ -77,7 +88,9 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, VectorTriadParallel)(benchmark::State& st
   unsigned long size = buf_size;
 
   buffers.reserve(parallelism);
+  std::chrono::duration<double> triad_duration{0};
   for (auto _ : state) {
+    auto start = std::chrono::high_resolution_clock::now();
     std::vector<cl::Event> kernels_done;
     kernels_done.reserve(parallelism);
     for (size_t kern = 0; kern < parallelism; kern++) {
@@ -90,6 +103,21 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, VectorTriadParallel)(benchmark::State& st
           kernel, NULL, std::addressof(kernels_done.back()));
     }
     cl::Event::waitForEvents(kernels_done);
+    triad_duration += std::chrono::high_resolution_clock::now() - start;
+  }
+
+  // The kernels run concurrently, each of them moved its buffers in the
+  // measured time.
+  const double triads = static_cast<double>(size) * state.iterations();
+  for (size_t kern = 1; kern <= parallelism; kern++) {
+    std::stringstream ss;
+    ss << "vector_triad" << kern;
+    forecast::calibration().record_flops(
+        file_stream.str(), ss.str(), 2 * triads / triad_duration.count());
+    forecast::calibration().record_bandwidth(
+        file_stream.str(),
+        ss.str(),
+        4 * sizeof(value_t) * triads / triad_duration.count());
   }
 
   state.SetBytesProcessed(
@@ -97,12 +125,10 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, VectorTriadParallel)(benchmark::State& st
       size_t(state.range(1)) * sizeof(value_t));
 
   for(auto& buffer : buffers) {
-    const bool valid = buffer[0].validate(clstate.queue, [](const auto& val){
+    const auto valid = buffer[0].validate(clstate.queue, [](const auto& val){
         return val == 1 * 2 + 3;
     });
-    if (!valid) {
-      state.SkipWithError("Validation failed.");
-    }
+    report_validation(state, valid);
   }
 }
 
@@ -132,11 +158,13 @@ void DGEMM(benchmark::State& state, std::string config, T)
   const cl::NDRange global_work_size(N, N);
   const cl::NDRange local_work_size(block_size, block_size);
 
+  std::chrono::duration<double> mmult_duration{0};
   for (auto _ : state) {
     cl::Event kernel_done;
     set_bufs_as_args(kern, buffers);
     kern.setArg(3, static_cast<int>(N));
     kern.setArg(4, static_cast<int>(N));
+    auto start = std::chrono::high_resolution_clock::now();
     clstate.queue.enqueueNDRangeKernel(
         kern,
         cl::NullRange,
@@ -145,18 +173,19 @@ void DGEMM(benchmark::State& state, std::string config, T)
         NULL,
         std::addressof(kernel_done));
     kernel_done.wait();
+    mmult_duration += std::chrono::high_resolution_clock::now() - start;
   }
 
   const unsigned long long flops = N * N * N * 2 * state.iterations();
   state.counters["FLOPs"] =
       benchmark::Counter(flops, benchmark::Counter::kIsRate);
+  forecast::calibration().record_flops(
+      config, kernel_name, flops / mmult_duration.count());
 
-  bool valid = buffers[0].validate(clstate.queue, [N] (const auto& val) {
+  const auto valid = buffers[0].validate(clstate.queue, [N] (const auto& val) {
     return val == 6 * N;
   });
-  if (!valid) {
-    state.SkipWithError("Validation failed.");
-  }
+  report_validation(state, valid);
 }
 
 /**
@@ -219,9 +248,7 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, MatrixMultTriad)(benchmark::State& state)
 
   const auto valid = mbuf[0].validate(
       queue, [N](const auto& val) { return val == 2 * 3 * N; });
-  if(!valid) {
-    state.SkipWithError("Validation failed.");
-  }
+  report_validation(state, valid);
 }
 
 static void ParallelismRange(benchmark::internal::Benchmark* b)
@@ -305,9 +332,7 @@ BENCHMARK_DEFINE_F(BasicKernelFixture, MatrixMultTriadQueue)
 
   const auto valid = mbuf[0].validate(
       queue, [N](const auto& val) { return val == 2 * 3 * N; });
-  if(!valid) {
-    state.SkipWithError("Validation failed.");
-  }
+  report_validation(state, valid);
 }
 
 BENCHMARK_REGISTER_F(BasicKernelFixture, Empty)
@@ -0,0 +1,685 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <forecast/batching.h>
+#include <forecast/daemon.h>
+#include <forecast/multi_device.h>
+#include <forecast/scheduler.h>
+#include <forecast/sim_backend.h>
+#include <forecast/workload.h>
+#include <log.h>
+
+// Scheduler benchmarks on a simulated device, they need no FPGA
+
+forecast::Task sim_mmult(const std::string& kernel, size_t N)
+{
+  constexpr int block_size = 64;
+  return forecast::Task{
+      kernel,
+      {},
+      forecast::TaskDims{
+          cl::NDRange(N, N), cl::NDRange(block_size, block_size)}};
+}
+
+// Scheduler with a simulated device that owns its backend
+struct SimScheduler {
+  SimScheduler(forecast::SimParams params)
+    : device(new forecast::SimBackend(params))
+    , scheduler(std::unique_ptr<forecast::Backend>(device), "")
+  {
+  }
+
+  forecast::SimBackend* device;
+  forecast::Scheduler   scheduler;
+};
+
+// Host overhead of the scheduler, the device takes no time at all
+static void SimulatedOverhead(benchmark::State& state)
+{
+  forecast::SimParams params;
+  params.time_scale = 0;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config("mmult_f_d");
+
+  const size_t tasks = state.range(0);
+  for (auto _ : state) {
+    for (size_t i = 0; i < tasks; i++) {
+      scheduler.add_task(sim_mmult("matrixMult", 64));
+    }
+    scheduler.wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * tasks);
+}
+
+// Host cost of submitting a task by kernel name (handle:0) or by a
+// pre-registered handle (handle:1), draining the queues is not timed
+static void SimulatedSubmit(benchmark::State& state)
+{
+  forecast::SimParams params;
+  params.time_scale = 0;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config("mmult_f_d");
+
+  const bool   by_handle = state.range(0);
+  const auto   handle    = scheduler.register_kernel("matrixMult");
+  const size_t tasks     = 1000;
+  for (auto _ : state) {
+    for (size_t i = 0; i < tasks; i++) {
+      if (by_handle) {
+        scheduler.add_task(handle, sim_mmult("matrixMult", 64));
+      } else {
+        scheduler.add_task(sim_mmult("matrixMult", 64));
+      }
+    }
+    state.PauseTiming();
+    scheduler.wait();
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * tasks);
+}
+
+// Tasks per second through a device that does nothing, tasks come from a
+// registered kernel with an interned name. The models have a history of
+// measured tasks behind their predictions, with reorder:1 every task also
+// passes through the dispatcher.
+static void SchedulerThroughput(benchmark::State& state)
+{
+  forecast::Scheduler scheduler(std::make_unique<forecast::NullBackend>(), "");
+  scheduler.add_config("mmult_f_d");
+  if (state.range(2)) {
+    scheduler.enable_reordering();
+  }
+
+  const auto   handle = scheduler.register_kernel("matrixMult");
+  const auto*  name   = forecast::intern("matrixMult");
+  const size_t tasks  = state.range(0);
+  // Distinct sizes, so the online model fits them
+  std::vector<forecast::TaskDims> dims;
+  for (size_t n = 64; n <= 1024; n += 64) {
+    dims.push_back({cl::NDRange(n, n), cl::NDRange(64, 64)});
+  }
+  for (int64_t i = 0; i < state.range(1); i++) {
+    scheduler.add_task(
+        handle, forecast::Task(name, {}, dims[i % dims.size()]));
+  }
+  scheduler.wait();
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < tasks; i++) {
+      scheduler.add_task(
+          handle, forecast::Task(name, {}, dims[i % dims.size()]));
+    }
+    scheduler.wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * tasks);
+}
+
+// Alternate between two bitstreams, simulated 1000x faster than real time
+static void SimulatedMmultReconfigure(benchmark::State& state)
+{
+  forecast::SimParams params;
+  params.time_scale = 1e-3;
+  params.noise      = 0.05;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config("mmult_f_d");
+  scheduler.add_config("mmult_f_d2");
+
+  const size_t N         = state.range(0);
+  int          iteration = 0;
+  for (auto _ : state) {
+    scheduler.set_config(iteration++ % 2 ? "mmult_f_d2" : "mmult_f_d");
+    for (int a = 0; a < 10; a++) {
+      scheduler.add_task(sim_mmult("matrixMult", N));
+      scheduler.add_task(sim_mmult("matrixMultD", N));
+    }
+    scheduler.wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * 20);
+  state.counters["reconfigurations"] =
+      benchmark::Counter(sim.device->reconfigurations());
+}
+
+// Open-loop arrivals at state.range(0) percent of the device's capacity,
+// Poisson (state.range(1) == 0) or bursty. Latencies in simulated seconds.
+static void SimulatedOpenLoop(benchmark::State& state)
+{
+  forecast::SimParams params;
+  // Slow enough that thread wake-ups do not eat into the capacity
+  params.time_scale = 5e-2;
+  params.noise      = 0.05;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config("mmult_f_d");
+
+  constexpr size_t N = 1024;
+  const forecast::TaskDims dims{cl::NDRange(N, N), cl::NDRange(64, 64)};
+  forecast::Workload       workload;
+  workload.add_kernel(0.6, "matrixMult", {}, dims);
+  workload.add_kernel(0.4, "matrixMultD", {}, dims);
+
+  // Mean time the device needs per task
+  const double service =
+      0.6 * sim.device->duration("mmult_f_d", sim_mmult("matrixMult", N)) +
+      0.4 * sim.device->duration("mmult_f_d", sim_mmult("matrixMultD", N));
+  const double rate = state.range(0) / 100.0 / service;
+  std::unique_ptr<forecast::ArrivalProcess> arrivals;
+  if (state.range(1)) {
+    arrivals = std::make_unique<forecast::BurstyArrivals>(rate, 20 * service);
+  } else {
+    arrivals = std::make_unique<forecast::PoissonArrivals>(rate);
+  }
+  auto generator = workload.generator(std::move(arrivals));
+
+  forecast::LatencyRecorder latencies;
+  scheduler.set_completion_observer(
+      [&latencies](const forecast::Task& task) { latencies.record(task); });
+
+  constexpr size_t tasks = 200;
+  double           lag   = 0;
+  for (auto _ : state) {
+    lag = std::max(
+        lag,
+        forecast::run_open_loop(scheduler, generator, tasks, params.time_scale));
+    scheduler.wait();
+  }
+  scheduler.set_completion_observer(nullptr);
+
+  const auto sorted = latencies.sorted();
+  auto       counter = [&sorted, &params](double p) {
+    return benchmark::Counter(
+        forecast::percentile(sorted, p) / params.time_scale);
+  };
+  state.SetItemsProcessed(state.iterations() * tasks);
+  state.counters["p50"]  = counter(0.5);
+  state.counters["p99"]  = counter(0.99);
+  state.counters["p999"] = counter(0.999);
+  state.counters["service"] = benchmark::Counter(service);
+  state.counters["max_lag"] = benchmark::Counter(lag / params.time_scale);
+}
+
+// Random mix of matrixMult and matrixMultD, which run best on different
+// bitstreams. reorder:0 switches to the best bitstream in arrival order,
+// reorder:1 leaves that to the reordering window.
+static void SimulatedMmultRandom(benchmark::State& state)
+{
+  forecast::SimParams params;
+  params.time_scale = 1e-3;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config("mmult_f_d");
+  scheduler.add_config("mmult_f_d2");
+
+  const bool reorder = state.range(0);
+  if (reorder) {
+    scheduler.enable_reordering({32, 30});
+  }
+
+  constexpr size_t            N     = 2048;
+  constexpr size_t            tasks = 32;
+  forecast::Rng               rng(42);
+  std::bernoulli_distribution single(0.6);
+  for (auto _ : state) {
+    for (size_t i = 0; i < tasks; i++) {
+      const bool is_single = single(rng);
+      auto task = sim_mmult(is_single ? "matrixMult" : "matrixMultD", N);
+      const std::string best = is_single ? "mmult_f_d" : "mmult_f_d2";
+      if (!reorder && scheduler.current_config().bitstream() != best) {
+        scheduler.wait();
+        scheduler.set_config(best);
+      }
+      scheduler.add_task(std::move(task));
+    }
+    scheduler.wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * tasks);
+  state.counters["reconfigurations"] = benchmark::Counter(
+      sim.device->reconfigurations(), benchmark::Counter::kAvgIterations);
+}
+
+// Urgent small multiplies with a deadline arrive behind a batch of large
+// background ones. Reports the share of missed deadlines with FIFO queues
+// (order:0) and with priority and least-slack ordering (order:1).
+static void SimulatedDeadlines(benchmark::State& state)
+{
+  forecast::SimParams params;
+  params.time_scale = 1e-2;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config("mmult_f_d");
+  // Misses are counted, not warned about
+  scheduler.set_admission(forecast::Admission::Accept);
+  if (state.range(0)) {
+    scheduler.set_queue_order(forecast::QueueOrder::Deadline);
+  }
+
+  // Two sizes teach the online model the scaled durations, the first task
+  // also loads the bitstream
+  scheduler.add_task(sim_mmult("matrixMult", 256));
+  scheduler.wait();
+  const auto begin = forecast::Clock::now();
+  scheduler.add_task(sim_mmult("matrixMult", 2048));
+  scheduler.wait();
+  const auto background = forecast::Clock::now() - begin;
+  scheduler.metrics().reset();
+
+  constexpr size_t batch = 8;
+  for (auto _ : state) {
+    for (size_t i = 0; i < batch; i++) {
+      auto task = sim_mmult("matrixMult", 2048);
+      task.set_priority(forecast::Priority::Background);
+      scheduler.add_task(std::move(task));
+    }
+    for (size_t i = 0; i < batch; i++) {
+      std::this_thread::sleep_for(background / 2);
+      auto task = sim_mmult("matrixMult", 256);
+      task.set_priority(forecast::Priority::Urgent);
+      task.set_deadline(forecast::Clock::now() + background * 3 / 2);
+      scheduler.add_task(std::move(task));
+    }
+    scheduler.wait();
+  }
+
+  const auto& kernel = scheduler.metrics().snapshot().kernels["matrixMult"];
+  state.SetItemsProcessed(state.iterations() * 2 * batch);
+  state.counters["miss_rate"] =
+      kernel.deadlines ? double(kernel.deadline_misses) / kernel.deadlines
+                       : 0;
+}
+
+// A triad that indexes by get_global_id, so its tasks can be launched on
+// sub-ranges, see forecast::Granularity
+forecast::Task sim_triad(size_t n)
+{
+  return forecast::Task{
+      "vector_triad_nd",
+      {},
+      forecast::TaskDims{cl::NDRange(n), cl::NDRange(64)}};
+}
+
+void set_sim_triad_params(const std::string& config)
+{
+  forecast::set_kernel_params(
+      config,
+      "vector_triad_nd",
+      {0,
+       forecast::vector_triad,
+       15e9,
+       forecast::vector_triad_bytes,
+       200e-6});
+}
+
+// Urgent small triads with a deadline arrive while one large background
+// triad runs on the same kernel. Whole (split:0), the large one holds the
+// queue until it is done, split into chunks (split:1) the urgent tasks run
+// in between.
+static void SimulatedSplit(benchmark::State& state)
+{
+  const std::string config = "sim_split";
+  set_sim_triad_params(config);
+
+  forecast::SimParams params;
+  params.time_scale = 1e-1;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config(config);
+  scheduler.set_admission(forecast::Admission::Accept);
+  scheduler.set_queue_order(forecast::QueueOrder::Deadline);
+
+  scheduler.add_task(sim_triad(1 << 14));
+  scheduler.wait();
+  const auto begin = forecast::Clock::now();
+  scheduler.add_task(sim_triad(1 << 22));
+  scheduler.wait();
+  const auto chunk = forecast::Clock::now() - begin;
+  if (state.range(0)) {
+    forecast::Granularity granularity;
+    granularity.chunk_seconds =
+        std::chrono::duration<double>(chunk).count() / 2;
+    granularity.offset_safe = true;
+    scheduler.set_granularity("vector_triad_nd", granularity);
+  }
+  scheduler.metrics().reset();
+
+  constexpr size_t urgent = 8;
+  for (auto _ : state) {
+    auto task = sim_triad(1 << 25);
+    task.set_priority(forecast::Priority::Background);
+    scheduler.add_task(std::move(task));
+    for (size_t i = 0; i < urgent; i++) {
+      std::this_thread::sleep_for(chunk / 2);
+      auto task = sim_triad(1 << 14);
+      task.set_priority(forecast::Priority::Urgent);
+      task.set_deadline(forecast::Clock::now() + chunk);
+      scheduler.add_task(std::move(task));
+    }
+    scheduler.wait();
+  }
+
+  const auto& kernel =
+      scheduler.metrics().snapshot().kernels["vector_triad_nd"];
+  state.SetItemsProcessed(state.iterations() * (1 + urgent));
+  state.counters["miss_rate"] =
+      kernel.deadlines ? double(kernel.deadline_misses) / kernel.deadlines
+                       : 0;
+}
+
+// A triad over a large array submitted as many small adjacent strips, each
+// launch pays a fixed latency. Coalescing (coalesce:1) launches runs of
+// waiting strips as one.
+static void SimulatedCoalesce(benchmark::State& state)
+{
+  const std::string config = "sim_coalesce";
+  set_sim_triad_params(config);
+
+  forecast::SimParams params;
+  params.time_scale = 1e-1;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config(config);
+  if (state.range(0)) {
+    forecast::Granularity granularity;
+    granularity.offset_safe = true;
+    scheduler.set_granularity("vector_triad_nd", granularity);
+  }
+
+  constexpr size_t strips = 256;
+  constexpr size_t strip  = 1 << 14;
+  uint64_t         key    = 0;
+  for (auto _ : state) {
+    key++;
+    for (size_t i = 0; i < strips; i++) {
+      forecast::TaskDims dims{cl::NDRange(strip), cl::NDRange(64)};
+      dims.offset = cl::NDRange(i * strip);
+      forecast::Task task("vector_triad_nd", {}, dims);
+      task.set_coalesce_key(key);
+      scheduler.add_task(std::move(task));
+    }
+    scheduler.wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * strips);
+  state.counters["launches"] = benchmark::Counter(
+      scheduler.metrics().snapshot().kernels["vector_triad_nd"].device.count,
+      benchmark::Counter::kAvgIterations);
+}
+
+// Single fft1d transforms arrive at 4000 per second, each launch costs 1ms
+// on top of the transforms. Batches gather while the device runs and wait up
+// to max_delay_us on an idle device, or the fixed launch cost the batcher
+// learns (tuned:1). Reports throughput and the p99 latency of a request.
+static void SimulatedBatching(benchmark::State& state)
+{
+  const std::string config = "sim_fft";
+  forecast::set_kernel_params(
+      config,
+      "fft1d",
+      {100 GFLOPS, forecast::fft_1d, 0, forecast::byte_function(""), 1e-3});
+  SimScheduler sim(forecast::SimParams{});
+  sim.scheduler.add_config(config);
+
+  constexpr size_t points = 1 << 14;
+  constexpr size_t bytes  = points * 2 * sizeof(float);
+  std::vector<char> device(bytes);
+  forecast::BatchKernel kernel;
+  kernel.input_bytes  = bytes;
+  kernel.output_bytes = bytes;
+  kernel.launch       = [&device](const char* inputs, size_t batch) {
+    // Stands in for the copy to the device buffer
+    std::memcpy(device.data(), inputs + (batch - 1) * bytes, bytes);
+    std::vector<forecast::Task> tasks;
+    tasks.emplace_back("fft1d", forecast::KernelGen{});
+    tasks.back().set_problem_size(batch * points);
+    return tasks;
+  };
+  kernel.collect = [&device](char* outputs, size_t batch) {
+    std::memcpy(outputs + (batch - 1) * bytes, device.data(), bytes);
+  };
+  forecast::BatchPolicy policy;
+  policy.max_delay = state.range(0) * 1e-6;
+  policy.tune      = state.range(1);
+  forecast::Batcher batcher(sim.scheduler, kernel, policy);
+
+  constexpr size_t          requests = 512;
+  const auto                interval = std::chrono::microseconds(250);
+  std::vector<char>         input(bytes), output(requests * bytes);
+  forecast::Histogram       latency;
+  // Loads the bitstream
+  batcher.submit(input.data(), output.data());
+  batcher.wait();
+  for (auto _ : state) {
+    auto next = forecast::Clock::now();
+    for (size_t i = 0; i < requests; i++) {
+      std::this_thread::sleep_until(next);
+      next += interval;
+      const auto arrived = forecast::Clock::now();
+      batcher.submit(
+          input.data(), output.data() + i * bytes, [&latency, arrived](bool) {
+            latency.record(forecast::Clock::now() - arrived);
+          });
+    }
+    batcher.wait();
+  }
+
+  const auto snapshot = latency.snapshot();
+  state.SetItemsProcessed(state.iterations() * requests);
+  state.counters["p99_ms"]     = snapshot.percentile(0.99) * 1e-6;
+  state.counters["batch"]      = batcher.mean_batch();
+  state.counters["window_us"]  = batcher.window() * 1e6;
+}
+
+// A compute-bound multiply and two memory-bound triads share a bitstream
+// and two compute units. Independent FIFO queues (coschedule:0) co-run any
+// two of them, the co-scheduler (coschedule:1) learns that the triads
+// contend and pairs each with the multiply instead.
+static void SimulatedCoRun(benchmark::State& state)
+{
+  const std::string config = "sim_corun";
+  forecast::set_kernel_params(
+      config,
+      "matrixMult",
+      {120 GFLOPS,
+       forecast::matrix_mult,
+       0,
+       forecast::byte_function("matrixMult")});
+  for (const auto* triad : {"vector_triad1", "vector_triad2"}) {
+    forecast::set_kernel_params(
+        config,
+        triad,
+        {0, forecast::vector_triad, 15e9, forecast::vector_triad_bytes});
+  }
+
+  forecast::SimParams params;
+  params.time_scale       = 1e-1;
+  params.compute_units    = 2;
+  params.memory_bandwidth = 24e9;
+  params.contention       = 0.6;
+  SimScheduler sim(params);
+  auto&        scheduler = sim.scheduler;
+  scheduler.add_config(config);
+  if (state.range(0)) {
+    scheduler.enable_coscheduling(params.compute_units);
+  }
+
+  auto mmult = [](size_t N) { return sim_mmult("matrixMult", N); };
+  auto triad = [](const std::string& name, size_t n) {
+    forecast::Task task(name, {}, forecast::TaskDims{n, 1});
+    return task;
+  };
+
+  // Each kernel alone at two sizes, for the models to predict solo runs
+  for (size_t scale : {1, 2}) {
+    scheduler.add_task(mmult(512 * scale));
+    scheduler.wait();
+    for (const auto* name : {"vector_triad1", "vector_triad2"}) {
+      scheduler.add_task(triad(name, scale << 23));
+      scheduler.wait();
+    }
+  }
+
+  constexpr size_t rounds = 8;
+  for (auto _ : state) {
+    for (size_t i = 0; i < rounds; i++) {
+      scheduler.add_task(mmult(1024));
+      scheduler.add_task(triad("vector_triad1", 1 << 24));
+      scheduler.add_task(triad("vector_triad2", 1 << 24));
+    }
+    scheduler.wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * rounds * 3);
+}
+
+// Throughput of a matrixMult/matrixMultD mix over several simulated boards,
+// every task goes to the board predicted to finish it first
+static void SimulatedMultiDevice(benchmark::State& state)
+{
+  forecast::SimParams params;
+  params.time_scale = 1e-2;
+  std::vector<std::unique_ptr<forecast::Backend>> backends;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    backends.push_back(std::make_unique<forecast::SimBackend>(params));
+  }
+  forecast::MultiDeviceScheduler scheduler(
+      std::move(backends), "", params.reconfiguration * params.time_scale);
+  scheduler.add_config("mmult_f_d");
+  scheduler.add_config("mmult_f_d2");
+
+  constexpr size_t            tasks = 64;
+  forecast::Rng               rng(42);
+  std::bernoulli_distribution single(0.6);
+  for (auto _ : state) {
+    for (size_t i = 0; i < tasks; i++) {
+      scheduler.add_task(
+          sim_mmult(single(rng) ? "matrixMult" : "matrixMultD", 1024));
+    }
+    scheduler.wait();
+  }
+
+  state.SetItemsProcessed(state.iterations() * tasks);
+}
+
+// Tasks of several client processes, here threads with a connection each,
+// through one daemon. A buffer per task goes through shared memory.
+static void SimulatedDaemon(benchmark::State& state)
+{
+  forecast::SimParams params;
+  params.time_scale = 1e-2;
+  SimScheduler sim(params);
+  sim.scheduler.add_config("mmult_f_d");
+  sim.scheduler.add_task(sim_mmult("matrixMult", 64));
+  sim.scheduler.wait();
+
+  const auto path =
+      "/tmp/forecastd-bench-" + std::to_string(getpid()) + ".sock";
+  forecast::SchedulerDaemon daemon(sim.scheduler, path);
+
+  const auto         clients = static_cast<size_t>(state.range(0));
+  constexpr size_t   tasks   = 256;
+  constexpr size_t   bytes   = 64 * 64 * sizeof(float);
+  std::atomic<size_t> failed{0};
+  for (auto _ : state) {
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < clients; c++) {
+      threads.emplace_back([&]() {
+        forecast::DaemonClient client(path);
+        const auto& segment = client.allocate(bytes);
+        for (size_t i = 0; i < tasks / clients; i++) {
+          forecast::RemoteTask task(
+              "matrixMult",
+              {cl::NDRange(1024, 1024), cl::NDRange(64, 64)});
+          task.buffer(forecast::wire::ArgKind::InOut, segment, 0, bytes);
+          client.submit(task);
+        }
+        failed += client.wait();
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  state.counters["failed"] = failed.load();
+  state.SetItemsProcessed(state.iterations() * tasks);
+}
+
+BENCHMARK(SimulatedOverhead)
+    ->RangeMultiplier(10)
+    ->Range(10, 10000)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedSubmit)
+    ->ArgName("handle")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(SchedulerThroughput)
+    ->ArgsProduct({{10, 1000}, {0, 100, 10000}, {0, 1}})
+    ->ArgNames({"tasks", "history", "reorder"})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedSplit)
+    ->ArgName("split")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedCoalesce)
+    ->ArgName("coalesce")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedBatching)
+    ->ArgsProduct({{0, 250, 1000, 4000}, {0, 1}})
+    ->ArgNames({"max_delay_us", "tuned"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedCoRun)
+    ->ArgName("coschedule")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedMultiDevice)
+    ->ArgName("devices")
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedDaemon)
+    ->ArgName("clients")
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedDeadlines)
+    ->ArgName("order")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedMmultRandom)
+    ->ArgName("reorder")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedMmultReconfigure)
+    ->RangeMultiplier(2)
+    ->Range(1024, 8192)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(SimulatedOpenLoop)
+    ->ArgsProduct({{50, 80, 95}, {0, 1}})
+    ->ArgNames({"load", "bursty"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
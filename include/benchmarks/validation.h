@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <future>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <CL/cl.hpp>
+#include <benchmark/benchmark.h>
+#include <cl_error.h>
+#include <log.h>
+#include "spdlog/fmt/ostr.h"
+
+// Result of checking a device buffer against a predicate. Converts to true if
+// every element passed.
+struct ValidationResult {
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  explicit operator bool() const
+  {
+    return failures == 0;
+  }
+
+  // Merge the result of a range that starts at offset
+  void merge(const ValidationResult& other, std::size_t offset)
+  {
+    if (other.failures > 0) {
+      first_failure = std::min(first_failure, offset + other.first_failure);
+    }
+    failures += other.failures;
+    checked += other.checked;
+  }
+
+  template <typename OStream>
+  friend OStream& operator<<(OStream& os, const ValidationResult& r)
+  {
+    if (r.failures == 0) {
+      return os << r.checked << " elements valid";
+    }
+    return os << r.failures << " of " << r.checked
+              << " elements invalid, first at index " << r.first_failure;
+  }
+
+  std::size_t checked       = 0;
+  std::size_t failures      = 0;
+  std::size_t first_failure = npos;
+};
+
+// Elements read back from the device per chunk. Two chunks are in flight at
+// any time, one being transferred and one being checked.
+constexpr std::size_t validation_chunk_bytes = 32 * 1024 * 1024;
+
+template <typename T, typename Func>
+ValidationResult check_range(const T* data, std::size_t n, const Func& func)
+{
+  ValidationResult result;
+  result.checked = n;
+  // Count without branching so the compiler can vectorize the loop, the
+  // (rare) failure position is searched for afterwards.
+  std::size_t failures = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    failures += !func(data[i]);
+  }
+  if (failures > 0) {
+    result.failures      = failures;
+    result.first_failure = std::find_if_not(data, data + n, func) - data;
+  }
+  return result;
+}
+
+template <typename T, typename Func>
+ValidationResult
+check_parallel(const T* data, std::size_t n, const Func& func)
+{
+  const std::size_t threads =
+      std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+  const std::size_t slice = (n + threads - 1) / threads;
+
+  std::vector<std::future<ValidationResult>> slices;
+  for (std::size_t begin = slice; begin < n; begin += slice) {
+    const auto len = std::min(slice, n - begin);
+    slices.push_back(std::async(std::launch::async, [=, &func]() {
+      return check_range(data + begin, len, func);
+    }));
+  }
+
+  auto result = check_range(data, std::min(slice, n), func);
+  for (std::size_t i = 0; i < slices.size(); i++) {
+    result.merge(slices[i].get(), (i + 1) * slice);
+  }
+  return result;
+}
+
+// Read buf back in chunks and check every element with func. The transfer of
+// the next chunk overlaps with checking the current one.
+template <typename T, typename Func>
+ValidationResult validate_buffer(
+    const cl::CommandQueue& queue,
+    const cl::Buffer&       buf,
+    std::size_t             size,
+    const Func&             func)
+{
+  ValidationResult result;
+  if (size == 0) {
+    return result;
+  }
+
+  const std::size_t chunk = std::min(
+      size, std::max<std::size_t>(1, validation_chunk_bytes / sizeof(T)));
+  const std::size_t n_chunks = (size + chunk - 1) / chunk;
+  std::array<std::vector<T>, 2> staging{
+      std::vector<T>(chunk), std::vector<T>(n_chunks > 1 ? chunk : 0)};
+  std::array<cl::Event, 2> ready;
+
+  auto read_chunk = [&](std::size_t c) {
+    const auto offset = c * chunk;
+    const auto len    = std::min(chunk, size - offset);
+    auto&      slot   = staging[c % 2];
+    cl_ok(queue.enqueueReadBuffer(
+        buf,
+        CL_FALSE,
+        offset * sizeof(T),
+        len * sizeof(T),
+        slot.data(),
+        NULL,
+        std::addressof(ready[c % 2])));
+    cl_ok(queue.flush());
+  };
+
+  read_chunk(0);
+  for (std::size_t c = 0; c < n_chunks; c++) {
+    cl_ok(ready[c % 2].wait());
+    // The other slot has been checked already and can be refilled
+    if (c + 1 < n_chunks) {
+      read_chunk(c + 1);
+    }
+    const auto len = std::min(chunk, size - c * chunk);
+    result.merge(check_parallel(staging[c % 2].data(), len, func), c * chunk);
+  }
+
+  return result;
+}
+
+// Skip the benchmark with a descriptive error if validation failed
+bool report_validation(
+    benchmark::State& state, const ValidationResult& result)
+{
+  if (result) {
+    debug("Validation: {}", result);
+    return true;
+  }
+  const auto msg = fmt::format("Validation failed: {}", result);
+  warn(msg);
+  state.SkipWithError(msg.c_str());
+  return false;
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <log.h>
+
+#include "parameters.h"
+#include "task.h"
+
+namespace forecast {
+
+std::string tuning_db_path()
+{
+  const char* env = std::getenv("FORECAST_TUNING");
+  return env ? env : "logs/tuning.csv";
+}
+
+/**
+ * Local sizes the kernel may be launched with for the global range. A
+ * reqd_work_group_size (compile_size) is the only choice, otherwise every
+ * power of two per dimension that divides the global range, with at most
+ * max_size work-items in total and at least 1/16th of that, smaller groups
+ * rarely win.
+ */
+std::vector<cl::NDRange> legal_local_sizes(
+    const cl::NDRange&                global,
+    std::size_t                       max_size,
+    const std::array<std::size_t, 3>& compile_size = {0, 0, 0})
+{
+  const auto dims = global.dimensions();
+  if (dims == 0) {
+    return {};
+  }
+  if (compile_size[0] > 0) {
+    switch (dims) {
+      case 1: return {cl::NDRange(compile_size[0])};
+      case 2: return {cl::NDRange(compile_size[0], compile_size[1])};
+      default:
+        return {cl::NDRange(
+            compile_size[0], compile_size[1], compile_size[2])};
+    }
+  }
+
+  std::vector<std::array<std::size_t, 3>> sizes{{1, 1, 1}};
+  for (std::size_t d = 0; d < dims; d++) {
+    std::vector<std::array<std::size_t, 3>> extended;
+    for (const auto& size : sizes) {
+      const auto used = size[0] * size[1] * size[2];
+      for (std::size_t e = 1; e <= global[d] && used * e <= max_size;
+           e *= 2) {
+        if (global[d] % e == 0) {
+          auto next = size;
+          next[d]   = e;
+          extended.push_back(next);
+        }
+      }
+    }
+    sizes = std::move(extended);
+  }
+
+  std::vector<cl::NDRange> legal;
+  const auto min_size = std::max<std::size_t>(1, max_size / 16);
+  for (const auto& size : sizes) {
+    if (size[0] * size[1] * size[2] < min_size) {
+      continue;
+    }
+    switch (dims) {
+      case 1: legal.emplace_back(size[0]); break;
+      case 2: legal.emplace_back(size[0], size[1]); break;
+      default: legal.emplace_back(size[0], size[1], size[2]);
+    }
+  }
+  return legal;
+}
+
+/**
+ * Picks the local size of tasks that leave it unspecified, per
+ * configuration, kernel and problem size bucket. Until a bucket is tuned,
+ * its tasks try the legal local sizes in turn, samples times each. The
+ * fastest by seconds per element then goes into the tuning database, a CSV
+ * file that later runs load.
+ */
+class Autotuner {
+public:
+  void enable(
+      const std::string& path = tuning_db_path(), unsigned samples = 3)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    _path    = path;
+    _samples = samples;
+    load();
+    _enabled.store(true, std::memory_order_relaxed);
+  }
+
+  bool enabled() const
+  {
+    return _enabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Local size to launch the task with, one of legal. Tasks of a bucket
+   * may have global ranges the tuned size or the candidates of a running
+   * search do not divide: they search again with their own legal sizes,
+   * or launch with the first one while another search runs.
+   */
+  cl::NDRange choose(
+      const std::string&              config,
+      const Task&                     task,
+      const std::vector<cl::NDRange>& legal)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    const auto                  k     = key(config, task);
+    auto                        tuned = _tuned.find(k);
+    if (tuned != _tuned.end() && contains(legal, tuned->second.local)) {
+      return tuned->second.local;
+    }
+    if (legal.size() <= 1) {
+      return legal.empty() ? cl::NullRange : legal.front();
+    }
+    auto& search = _searches[k];
+    if (search.candidates.empty()) {
+      search.candidates = legal;
+      search.seconds.assign(legal.size(), 0);
+      search.samples.assign(legal.size(), 0);
+      search.launched.assign(legal.size(), 0);
+    }
+    // The legal candidate launched least often so far
+    std::size_t next = search.candidates.size();
+    for (std::size_t i = 0; i < search.candidates.size(); i++) {
+      if (contains(legal, search.candidates[i]) &&
+          (next == search.candidates.size() ||
+           search.launched[i] < search.launched[next])) {
+        next = i;
+      }
+    }
+    if (next == search.candidates.size()) {
+      return legal.front();
+    }
+    search.launched[next]++;
+    return search.candidates[next];
+  }
+
+  // Seconds the task took with the local size choose() returned
+  void record(
+      const std::string& config,
+      const Task&        task,
+      const cl::NDRange& local,
+      double             seconds)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    const auto                  k  = key(config, task);
+    auto                        it = _searches.find(k);
+    if (it == _searches.end()) {
+      return;
+    }
+    auto& search = it->second;
+    for (std::size_t i = 0; i < search.candidates.size(); i++) {
+      if (same(search.candidates[i], local)) {
+        search.seconds[i] +=
+            seconds / std::max<std::size_t>(1, task.problem_size());
+        search.samples[i]++;
+      }
+    }
+    if (*std::min_element(search.samples.begin(), search.samples.end()) <
+        _samples) {
+      return;
+    }
+
+    std::size_t best = 0;
+    for (std::size_t i = 1; i < search.candidates.size(); i++) {
+      if (search.seconds[i] / search.samples[i] <
+          search.seconds[best] / search.samples[best]) {
+        best = i;
+      }
+    }
+    _tuned[k] = {
+        search.candidates[best], search.seconds[best] / search.samples[best]};
+    info(
+        "Tuned {} in {} for 2^{} elements: local size {}",
+        std::get<1>(k),
+        std::get<0>(k),
+        std::get<2>(k),
+        format(search.candidates[best]));
+    _searches.erase(it);
+    save();
+  }
+
+private:
+  // Configuration, kernel, size bucket
+  using Key = std::tuple<std::string, std::string, std::size_t>;
+
+  struct Tuned {
+    cl::NDRange local;
+    // Per element of the problem
+    double seconds = 0;
+  };
+
+  struct Search {
+    std::vector<cl::NDRange> candidates;
+    std::vector<double>      seconds;
+    std::vector<unsigned>    samples;
+    // Ahead of samples while tasks run
+    std::vector<unsigned>    launched;
+  };
+
+  static Key key(const std::string& config, const Task& task)
+  {
+    return {config, task.function_name(), size_bucket(task.problem_size())};
+  }
+
+  static bool same(const cl::NDRange& a, const cl::NDRange& b)
+  {
+    if (a.dimensions() != b.dimensions()) {
+      return false;
+    }
+    for (std::size_t d = 0; d < a.dimensions(); d++) {
+      if (a[d] != b[d]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static bool contains(
+      const std::vector<cl::NDRange>& ranges, const cl::NDRange& range)
+  {
+    return std::any_of(ranges.begin(), ranges.end(), [&range](auto& r) {
+      return same(r, range);
+    });
+  }
+
+  static std::string format(const cl::NDRange& range)
+  {
+    std::string out;
+    for (std::size_t d = 0; d < range.dimensions(); d++) {
+      out += (d ? "x" : "") + std::to_string(range[d]);
+    }
+    return out;
+  }
+
+  // Requires _m. Every line: config, kernel, bucket, l0, l1, l2, seconds,
+  // malformed lines are skipped
+  void load()
+  {
+    std::ifstream in(_path);
+    std::string   line;
+    std::size_t   number = 0;
+    while (std::getline(in, line)) {
+      number++;
+      std::stringstream ss(line);
+      std::string       config, kernel, field;
+      std::getline(ss >> std::ws, config, ',');
+      std::getline(ss >> std::ws, kernel, ',');
+      if (config.empty() || config == "config") {
+        continue;
+      }
+      std::vector<double> values;
+      bool                valid = true;
+      while (valid && std::getline(ss >> std::ws, field, ',')) {
+        double value = 0;
+        valid        = parse_double(field, value) && value >= 0;
+        values.push_back(value);
+      }
+      if (!valid || values.size() != 5) {
+        warn("Skipping malformed line {} of {}: {}", number, _path, line);
+        continue;
+      }
+      const auto l0 = static_cast<std::size_t>(values[1]);
+      const auto l1 = static_cast<std::size_t>(values[2]);
+      const auto l2 = static_cast<std::size_t>(values[3]);
+      cl::NDRange local =
+          l2 > 0 ? cl::NDRange(l0, l1, l2)
+                 : l1 > 0 ? cl::NDRange(l0, l1) : cl::NDRange(l0);
+      _tuned[{config, kernel, static_cast<std::size_t>(values[0])}] = {
+          local, values[4]};
+    }
+    debug("Loaded {} tuned local sizes from {}", _tuned.size(), _path);
+  }
+
+  // Requires _m
+  void save() const
+  {
+    std::ofstream out(_path, std::ios::trunc);
+    out << "config, kernel, bucket, l0, l1, l2, seconds\n";
+    for (const auto& tuned : _tuned) {
+      const auto& local = tuned.second.local;
+      out << std::get<0>(tuned.first) << ", " << std::get<1>(tuned.first)
+          << ", " << std::get<2>(tuned.first);
+      for (std::size_t d = 0; d < 3; d++) {
+        out << ", " << (d < local.dimensions() ? local[d] : 0);
+      }
+      out << ", " << tuned.second.seconds << "\n";
+    }
+    if (!out) {
+      warn("Could not write the tuning database {}", _path);
+    }
+  }
+
+  std::atomic<bool>     _enabled{false};
+  std::mutex            _m;
+  std::string           _path;
+  unsigned              _samples = 3;
+  std::map<Key, Tuned>  _tuned;
+  std::map<Key, Search> _searches;
+};
+
+Autotuner& autotuner()
+{
+  static Autotuner autotuner;
+  return autotuner;
+}
+
+}  // namespace forecast
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "task.h"
+
+#include <memory>
+#include <string>
+
+namespace forecast {
+
+/**
+ * Executes the tasks of one Queue in order, like a cl::CommandQueue.
+ */
+class Stream {
+public:
+  virtual ~Stream() = default;
+
+  // Start the task with the currently active bitstream
+  virtual void launch(Task& task) = 0;
+
+  // Block until the launched task has finished on the device
+  virtual void wait(Task& task) = 0;
+};
+
+/**
+ * The device the scheduler runs on. Hides whether tasks run on a real
+ * OpenCL device or a simulated one.
+ */
+class Backend {
+public:
+  virtual ~Backend() = default;
+
+  // Make a bitstream available for activation, e.g. build its program
+  virtual void prepare(const std::string& bitstream) = 0;
+
+  // Tasks launched from now on use the kernels of this bitstream
+  virtual void activate(const std::string& bitstream) = 0;
+
+  virtual std::unique_ptr<Stream> create_stream() = 0;
+
+  // Identifies the device and driver that models are learned on
+  virtual std::string identity() const = 0;
+
+  // NUMA node of the device, where the threads that feed it run, -1 if
+  // unknown
+  virtual int numa_node() const
+  {
+    return -1;
+  }
+};
+
+}  // namespace forecast
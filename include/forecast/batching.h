@@ -0,0 +1,285 @@
+#pragma once
+
+#include "model.h"
+#include "numa.h"
+#include "scheduler.h"
+#include "task.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace forecast {
+
+struct BatchPolicy {
+  // Requests per launch
+  std::size_t max_batch = 64;
+  // Seconds the oldest request waits for others while the device is idle
+  double max_delay = 2e-3;
+  // Wait at most the fixed cost of a launch the model predicts, longer
+  // waits cost more latency than the launches they save
+  bool tune = true;
+};
+
+/**
+ * How a batch-capable kernel such as fft1d runs packed requests. launch
+ * gets the inputs of batch requests, input_bytes each and back to back,
+ * copies them to the device and returns the tasks that process them all,
+ * e.g. fetch and fft1d with iterations = batch. The last of the tasks
+ * finishes the batch, collect then copies the outputs back to the host,
+ * output_bytes per request and back to back.
+ */
+struct BatchKernel {
+  std::size_t input_bytes  = 0;
+  std::size_t output_bytes = 0;
+  std::function<std::vector<Task>(const char* inputs, std::size_t batch)>
+                                                         launch;
+  std::function<void(char* outputs, std::size_t batch)> collect;
+};
+
+/**
+ * Gathers requests that arrive one at a time into batches in front of the
+ * scheduler. One batch is on the device at a time, so the kernel's buffers
+ * can be reused: requests gather while it runs and launch together once it
+ * is done. An idle device waits up to the window for more requests. With
+ * BatchPolicy::tune the window is the fixed cost of a launch, fit online
+ * to the device time of the batches over their sizes like the scheduler's
+ * models.
+ */
+class Batcher {
+public:
+  // Called with false if the batch could not be launched or failed on the
+  // device, the output is not written then
+  using Done = std::function<void(bool ok)>;
+
+  Batcher(
+      Scheduler& scheduler, BatchKernel kernel, BatchPolicy policy = {})
+    : _scheduler(scheduler)
+    , _kernel(std::move(kernel))
+    , _policy(policy)
+    , _inputs(NumaAllocator<char>(scheduler.backend().numa_node()))
+    , _outputs(NumaAllocator<char>(scheduler.backend().numa_node()))
+    , _thread(&Batcher::batch_loop, this)
+  {
+  }
+
+  ~Batcher()
+  {
+    wait();
+    {
+      std::lock_guard<std::mutex> lg(_m);
+      _stop = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+  }
+
+  // Input and output have to stay valid until done is called, on a queue
+  // thread of the scheduler or on the batch thread if it rejected the batch
+  void submit(const void* input, void* output, Done done = {})
+  {
+    {
+      std::lock_guard<std::mutex> lg(_m);
+      _requests.push_back({input, output, std::move(done), Clock::now()});
+    }
+    _cv.notify_all();
+  }
+
+  // Until every submitted request is done
+  void wait()
+  {
+    std::unique_lock<std::mutex> lk(_m);
+    _cv.wait(lk, [this]() { return _requests.empty() && !_in_flight; });
+  }
+
+  // Seconds an idle device currently waits for more requests
+  double window() const
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    return current_window();
+  }
+
+  // Requests per launch so far
+  double mean_batch() const
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    return _batches ? static_cast<double>(_batched) / _batches : 0;
+  }
+
+private:
+  struct Request {
+    const void* input;
+    void*       output;
+    Done        done;
+    TimePoint   arrived;
+  };
+
+  // A batch on the device, done when the last of its accepted tasks is
+  struct Launch {
+    std::vector<Request>     batch;
+    std::atomic<std::size_t> pending{0};
+    std::atomic<bool>        failed{false};
+  };
+
+  // Requires _m
+  double current_window() const
+  {
+    if (!_policy.tune || _statistics.n < 2 || _statistics.m2_x <= 0) {
+      return _policy.max_delay;
+    }
+    const auto beta  = _statistics.c_xy / _statistics.m2_x;
+    const auto alpha = _statistics.mean_y - beta * _statistics.mean_x;
+    return std::clamp(alpha, 0.0, _policy.max_delay);
+  }
+
+  void batch_loop()
+  {
+    pin_current_thread(_scheduler.backend().numa_node());
+    std::unique_lock<std::mutex> lk(_m);
+    while (true) {
+      _cv.wait(lk, [this]() {
+        return _stop || (!_requests.empty() && !_in_flight);
+      });
+      if (_stop) {
+        return;
+      }
+      const auto until =
+          _requests.front().arrived +
+          std::chrono::duration_cast<Clock::duration>(
+              std::chrono::duration<double>(current_window()));
+      Clock::wait_until(_cv, lk, until, [this]() {
+        return _stop || _requests.size() >= _policy.max_batch;
+      });
+
+      const auto size = std::min(_requests.size(), _policy.max_batch);
+      std::vector<Request> batch(
+          std::make_move_iterator(_requests.begin()),
+          std::make_move_iterator(_requests.begin() + size));
+      _requests.erase(_requests.begin(), _requests.begin() + size);
+      _in_flight = true;
+      lk.unlock();
+
+      _inputs.resize(size * _kernel.input_bytes);
+      for (std::size_t i = 0; i < size; i++) {
+        std::memcpy(
+            _inputs.data() + i * _kernel.input_bytes,
+            batch[i].input,
+            _kernel.input_bytes);
+      }
+      auto tasks = _kernel.launch(_inputs.data(), size);
+      assert(!tasks.empty());
+      auto launch   = std::make_shared<Launch>();
+      launch->batch = std::move(batch);
+      launch->pending.store(tasks.size(), std::memory_order_relaxed);
+      for (auto& task : tasks) {
+        task.set_completion([this, launch](const Task& t) {
+          if (t.status() != CL_SUCCESS) {
+            launch->failed.store(true, std::memory_order_relaxed);
+          }
+          done(*launch, 1, &t);
+        });
+      }
+      // Tasks accepted before a rejected one still run, the batch fails
+      // once they are done so the next one does not overwrite their buffers
+      std::size_t accepted = 0;
+      while (accepted < tasks.size() &&
+             _scheduler.add_task(std::move(tasks[accepted]))) {
+        accepted++;
+      }
+      if (accepted < tasks.size()) {
+        warn(
+            "The scheduler rejected task {} of a batch of {} requests",
+            tasks[accepted].function_name(),
+            size);
+        launch->failed.store(true, std::memory_order_relaxed);
+        done(*launch, tasks.size() - accepted, nullptr);
+      }
+      lk.lock();
+    }
+  }
+
+  // Counts tasks of the launch off, the last one finishes the batch, on its
+  // queue thread or on the batch thread if it was rejected
+  void done(Launch& launch, std::size_t tasks, const Task* last)
+  {
+    if (launch.pending.fetch_sub(tasks, std::memory_order_acq_rel) !=
+        tasks) {
+      return;
+    }
+    if (launch.failed.load(std::memory_order_relaxed)) {
+      failed(launch.batch);
+    } else {
+      finished(launch.batch, *last);
+    }
+  }
+
+  void finished(std::vector<Request>& batch, const Task& last)
+  {
+    _outputs.resize(batch.size() * _kernel.output_bytes);
+    _kernel.collect(_outputs.data(), batch.size());
+    for (std::size_t i = 0; i < batch.size(); i++) {
+      std::memcpy(
+          batch[i].output,
+          _outputs.data() + i * _kernel.output_bytes,
+          _kernel.output_bytes);
+      if (batch[i].done) {
+        batch[i].done(true);
+      }
+    }
+
+    // On the device, without a reconfiguration before
+    const std::chrono::duration<double> took =
+        last.finished_at() - last.started_at();
+    {
+      std::lock_guard<std::mutex> lg(_m);
+      _statistics.add({took.count(), static_cast<double>(batch.size())});
+      _batches++;
+      _batched += batch.size();
+      _in_flight = false;
+    }
+    _cv.notify_all();
+  }
+
+  void failed(std::vector<Request>& batch)
+  {
+    for (auto& request : batch) {
+      if (request.done) {
+        request.done(false);
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lg(_m);
+      _in_flight = false;
+    }
+    _cv.notify_all();
+  }
+
+  Scheduler&              _scheduler;
+  BatchKernel             _kernel;
+  BatchPolicy             _policy;
+  mutable std::mutex      _m;
+  std::condition_variable _cv;
+  std::deque<Request>     _requests;
+  bool                    _in_flight = false;
+  bool                    _stop      = false;
+  // Seconds per launch over requests per launch
+  Statistics              _statistics;
+  uint64_t                _batches = 0;
+  uint64_t                _batched = 0;
+  // Packed requests on the board's node, only touched by the batch in
+  // flight
+  HostVector<char>        _inputs;
+  HostVector<char>        _outputs;
+  std::thread             _thread;
+};
+
+}  // namespace forecast
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "model.h"
+#include "parameters.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <log.h>
+
+namespace forecast {
+
+/**
+ * Collects peak compute and bandwidth figures while the benchmarks run and
+ * writes them as a parameter file for kernel_params().
+ *
+ * Benchmarks only report to it when calibration has been enabled. Every
+ * (config, kernel) pair keeps the best value seen, so the largest problem
+ * sizes of a benchmark range define the roofline.
+ */
+class Calibration {
+public:
+  void enable()
+  {
+    _enabled = true;
+  }
+
+  bool enabled() const
+  {
+    return _enabled;
+  }
+
+  void record_flops(
+      const std::string& config, const std::string& kernel, double flops)
+  {
+    if (!_enabled) return;
+    std::lock_guard<std::mutex> lg(_m);
+    auto& peak = _peaks[{config, kernel}];
+    peak.first = std::max(peak.first, flops);
+  }
+
+  void record_bandwidth(
+      const std::string& config, const std::string& kernel, double bytes)
+  {
+    if (!_enabled) return;
+    std::lock_guard<std::mutex> lg(_m);
+    auto& peak  = _peaks[{config, kernel}];
+    peak.second = std::max(peak.second, bytes);
+  }
+
+  void record_transfer(std::size_t bytes, double seconds)
+  {
+    if (!_enabled) return;
+    std::lock_guard<std::mutex> lg(_m);
+    _transfers.push_back({seconds, static_cast<double>(bytes)});
+  }
+
+  /**
+   * Fit seconds = latency + bytes / bandwidth through the recorded
+   * transfers with least squares. Returns (latency, bandwidth), the
+   * bandwidth is 0 if the transfers do not grow with their size.
+   */
+  std::pair<double, double> fit_transfers() const
+  {
+    const double m = _transfers.size();
+    double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    for (const auto& t : _transfers) {
+      sum_x += t.x;
+      sum_y += t.y;
+      sum_xx += t.x * t.x;
+      sum_xy += t.x * t.y;
+    }
+    const double denom = m * sum_xx - sum_x * sum_x;
+    if (m < 2 || denom <= 0) {
+      return {0, m > 0 && sum_y > 0 ? sum_x / sum_y : 0};
+    }
+    const double beta  = (m * sum_xy - sum_x * sum_y) / denom;
+    const double alpha = (sum_y - beta * sum_x) / m;
+    return {std::max(alpha, 0.0), beta > 0 ? 1 / beta : 0};
+  }
+
+  bool write(const std::string& path) const
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    std::ofstream out(path);
+    if (!out) {
+      warn("Could not write calibration to {}", path);
+      return false;
+    }
+    out << "config, kernel, max_flops, max_bandwidth, latency\n";
+    for (const auto& peak : _peaks) {
+      out << peak.first.first << ", " << peak.first.second << ", "
+          << peak.second.first << ", " << peak.second.second << ", 0\n";
+    }
+    const auto link = fit_transfers();
+    if (!_transfers.empty() && link.second <= 0) {
+      warn("Not writing host transfers, their fit has no bandwidth");
+    } else if (!_transfers.empty()) {
+      out << host_config << ", " << transfer_kernel << ", 0, " << link.second
+          << ", " << link.first << "\n";
+      info(
+          "Host transfers: {}s latency, {} bytes/s",
+          link.first,
+          link.second);
+    }
+    info("Wrote {} calibrated kernel parameters to {}", _peaks.size(), path);
+    return true;
+  }
+
+private:
+  using Key = std::pair<std::string, std::string>;
+
+  bool                                        _enabled = false;
+  mutable std::mutex                          _m;
+  // (config, kernel) -> (FLOP/s, bytes/s)
+  std::map<Key, std::pair<double, double>>    _peaks;
+  // (seconds, bytes) per Bandwidth run
+  std::vector<Measurement>                    _transfers;
+};
+
+Calibration& calibration()
+{
+  static Calibration calibration;
+  return calibration;
+}
+
+}  // namespace forecast
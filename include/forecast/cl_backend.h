@@ -0,0 +1,203 @@
+#pragma once
+
+#include "autotune.h"
+#include "backend.h"
+#include "numa.h"
+#include "program_cache.h"
+#include "tracer.h"
+
+#include <CL/cl.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <util.h>
+
+namespace forecast {
+
+/**
+ * Runs tasks on the devices of an OpenCL context with the programs of
+ * build_program, prebuilt binaries or kernel sources.
+ */
+class ClBackend : public Backend {
+public:
+  ClBackend(cl::Context* ctx)
+    : _ctx(ctx)
+    , _devices(ctx->getInfo<CL_CONTEXT_DEVICES>())
+    , _numa_node(_devices.empty() ? -1 : board_numa_node(_devices.front()))
+  {
+  }
+
+  // With a context of its own, e.g. one backend per board
+  explicit ClBackend(const cl::Device& device)
+    : _own_ctx(std::make_unique<cl::Context>(device))
+    , _ctx(_own_ctx.get())
+    , _devices{device}
+    , _numa_node(board_numa_node(device))
+  {
+  }
+
+  void prepare(const std::string& bitstream) override
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    if (_programs.count(bitstream)) {
+      return;
+    }
+    _programs.emplace(bitstream, build_program(*_ctx, _devices, bitstream));
+  }
+
+  void activate(const std::string& bitstream) override
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    _active      = std::addressof(_programs.at(bitstream));
+    _active_name = bitstream;
+  }
+
+  std::unique_ptr<Stream> create_stream() override;
+
+  int numa_node() const override
+  {
+    return _numa_node;
+  }
+
+  std::string identity() const override
+  {
+    if (_devices.empty()) {
+      return "";
+    }
+    return _devices.front().getInfo<CL_DEVICE_NAME>() + "/" +
+           _devices.front().getInfo<CL_DRIVER_VERSION>();
+  }
+
+  cl::Context& context()
+  {
+    return *_ctx;
+  }
+
+  cl::Program& active_program()
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    assert(_active != nullptr);
+    return *_active;
+  }
+
+  std::string active_bitstream()
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    return _active_name;
+  }
+
+  // Streams launch on the first device of the context
+  const cl::Device& device() const
+  {
+    return _devices.front();
+  }
+
+private:
+  std::unique_ptr<cl::Context>       _own_ctx;
+  cl::Context*                       _ctx;
+  std::vector<cl::Device>            _devices;
+  int                                _numa_node;
+  std::mutex                         _m;
+  std::map<std::string, cl::Program> _programs;
+  cl::Program*                       _active = nullptr;
+  std::string                        _active_name;
+};
+
+class ClStream : public Stream {
+public:
+  // Profiling is only enabled for traces, it costs time on some boards
+  ClStream(ClBackend& backend)
+    : _backend(backend)
+    , _profiling(tracer().enabled())
+    , _command_queue(
+          backend.context(), _profiling ? CL_QUEUE_PROFILING_ENABLE : 0)
+  {
+  }
+
+  void launch(Task& task) override
+  {
+    auto& kernel      = task.generate_kernel(_backend.active_program());
+    auto& kernel_done = task.kernel_done();
+    _tuning           = false;
+    if (!kernel()) {
+      // The kernel generator failed, only this task does
+      task.enqueued_now();
+      task.set_status(CL_INVALID_KERNEL);
+      return;
+    }
+    _local  = task.local();
+    _tuning = !task.has_local() && autotuner().enabled();
+    if (_tuning) {
+      _local = tuned_local(task, kernel);
+    }
+    task.enqueued_now();
+    const auto err = _command_queue.enqueueNDRangeKernel(
+        kernel,
+        task.offset(),
+        task.global(),
+        _local,
+        NULL,
+        std::addressof(kernel_done));
+    if (err != CL_SUCCESS) {
+      warn("Cannot launch {}: {}", task, clGetErrorString(err));
+      task.set_status(err);
+      _tuning = false;
+    }
+  }
+
+  void wait(Task& task) override
+  {
+    if (task.status() != CL_SUCCESS) {
+      return;
+    }
+    auto& kernel_done = task.kernel_done();
+    kernel_done.wait();
+    if (_profiling) {
+      // Device timestamps are in their own clock, relative to the enqueue
+      const auto queued =
+          kernel_done.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+      const auto start =
+          kernel_done.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+      task.set_started_at(
+          task.enqueued_at() +
+          std::chrono::duration_cast<Clock::duration>(
+              std::chrono::nanoseconds(start - queued)));
+    }
+    if (_tuning) {
+      const std::chrono::duration<double> seconds =
+          Clock::now() - task.started_at();
+      autotuner().record(_bitstream, task, _local, seconds.count());
+    }
+  }
+
+private:
+  cl::NDRange tuned_local(const Task& task, const cl::Kernel& kernel)
+  {
+    const auto& device  = _backend.device();
+    const auto  compile =
+        kernel.getWorkGroupInfo<CL_KERNEL_COMPILE_WORK_GROUP_SIZE>(device);
+    _bitstream = _backend.active_bitstream();
+    return autotuner().choose(
+        _bitstream,
+        task,
+        legal_local_sizes(
+            task.global(),
+            kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device),
+            {compile[0], compile[1], compile[2]}));
+  }
+
+  ClBackend&       _backend;
+  bool             _profiling;
+  cl::CommandQueue _command_queue;
+  // Of the running task, when its local size is being tuned
+  bool             _tuning = false;
+  cl::NDRange      _local;
+  std::string      _bitstream;
+};
+
+std::unique_ptr<Stream> ClBackend::create_stream()
+{
+  return std::make_unique<ClStream>(*this);
+}
+
+}  // namespace forecast
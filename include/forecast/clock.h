@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace forecast {
+
+/**
+ * Steady clock of the runtime. It runs rate() times as fast as the wall
+ * clock, 1 unless a simulation speeds it up, see Simulator. The scheduler
+ * then measures, predicts and waits in simulated seconds while a SimBackend
+ * finishes its kernels early in wall-clock time. Waiting on it has to go
+ * through sleep_until and wait_until, the standard library would wait for
+ * the same amount of wall-clock time.
+ */
+struct Clock {
+  using duration   = std::chrono::nanoseconds;
+  using rep        = duration::rep;
+  using period     = duration::period;
+  using time_point = std::chrono::time_point<Clock>;
+
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept
+  {
+    const auto  wall = std::chrono::steady_clock::now().time_since_epoch();
+    const auto& s    = state();
+    const auto  rate = s.rate.load(std::memory_order_acquire);
+    const auto  since =
+        duration(wall).count() - s.wall.load(std::memory_order_relaxed);
+    const auto clock = s.clock.load(std::memory_order_relaxed);
+    if (rate == 1) {
+      return time_point(duration(clock + since));
+    }
+    return time_point(duration(clock + static_cast<rep>(since * rate)));
+  }
+
+  static double rate()
+  {
+    return state().rate.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Let the clock run rate times as fast as the wall clock from now on, it
+   * continues from the current time. Only while no thread waits on it.
+   */
+  static void set_rate(double rate)
+  {
+    auto&      s     = state();
+    const auto clock = now();
+    s.wall.store(
+        duration(std::chrono::steady_clock::now().time_since_epoch())
+            .count(),
+        std::memory_order_relaxed);
+    s.clock.store(
+        clock.time_since_epoch().count(), std::memory_order_relaxed);
+    s.rate.store(rate, std::memory_order_release);
+  }
+
+  // Wall-clock time that passes while the clock advances by d
+  static std::chrono::steady_clock::duration wall(duration d)
+  {
+    const auto rate = Clock::rate();
+    if (rate == 1) {
+      return d;
+    }
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::nano>(d.count() / rate));
+  }
+
+  static void sleep_until(time_point t)
+  {
+    const auto left = t - now();
+    if (left > duration::zero()) {
+      std::this_thread::sleep_for(wall(left));
+    }
+  }
+
+  static std::cv_status wait_until(
+      std::condition_variable&      cv,
+      std::unique_lock<std::mutex>& lk,
+      time_point                    t)
+  {
+    if (t == time_point::max()) {
+      cv.wait(lk);
+      return std::cv_status::no_timeout;
+    }
+    const auto left = t - now();
+    if (left <= duration::zero()) {
+      return std::cv_status::timeout;
+    }
+    return cv.wait_for(lk, wall(left));
+  }
+
+  template <typename Predicate>
+  static bool wait_until(
+      std::condition_variable&      cv,
+      std::unique_lock<std::mutex>& lk,
+      time_point                    t,
+      Predicate                     done)
+  {
+    while (!done()) {
+      if (wait_until(cv, lk, t) == std::cv_status::timeout) {
+        return done();
+      }
+    }
+    return true;
+  }
+
+private:
+  struct State {
+    // Wall-clock and clock nanoseconds at the last set_rate
+    std::atomic<rep>    wall{0};
+    std::atomic<rep>    clock{0};
+    std::atomic<double> rate{1};
+  };
+
+  static State& state()
+  {
+    static State s;
+    return s;
+  }
+};
+
+}  // namespace forecast
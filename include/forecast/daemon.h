@@ -0,0 +1,756 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <cl_error.h>
+#include <log.h>
+
+#include "cl_backend.h"
+#include "scheduler.h"
+#include "task.h"
+
+namespace forecast {
+
+std::string daemon_socket_path()
+{
+  const char* env = std::getenv("FORECAST_SOCKET");
+  return env ? env : "/tmp/forecastd.sock";
+}
+
+/**
+ * Messages between the daemon and its clients, one per datagram of a
+ * SOCK_SEQPACKET socket. Both ends run on the same host, so the structs go
+ * over the wire as they are. Bulk data lives in shared memory segments a
+ * client creates with memfd_create and hands over as a file descriptor
+ * along with an Attach message.
+ */
+namespace wire {
+
+constexpr std::size_t name_size = 64;
+constexpr uint32_t    max_args  = 8;
+
+enum class ArgKind : uint8_t { Scalar, Input, Output, InOut };
+
+struct Arg {
+  ArgKind  kind;
+  uint32_t segment;
+  // Bytes into the segment, or of the scalar
+  uint64_t offset;
+  uint64_t size;
+  uint8_t  scalar[16];
+};
+
+struct Attach {
+  uint32_t segment;
+  uint64_t size;
+};
+
+struct Submit {
+  uint64_t tag;
+  char     kernel[name_size];
+  // Empty if any configuration with the kernel will do
+  char     config[name_size];
+  uint32_t dims;
+  uint64_t global[3];
+  uint64_t local[3];
+  uint64_t offset[3];
+  uint64_t problem_size;
+  Priority priority;
+  // Relative to the submission, 0 without a deadline
+  int64_t  deadline_ns;
+  uint32_t args;
+  Arg      arg[max_args];
+};
+
+struct Done {
+  uint64_t tag;
+  int32_t  status;
+  // Of the kernel, as the scheduler measured it
+  double   seconds;
+};
+
+enum class Type : uint32_t { Attach, Submit, Done };
+
+struct Message {
+  Message()
+  {
+    std::memset(static_cast<void*>(this), 0, sizeof(*this));
+  }
+
+  Type type;
+  union {
+    Attach attach;
+    Submit submit;
+    Done   done;
+  };
+};
+
+// fd is passed along if it is not negative
+bool send(int socket, const Message& message, int fd = -1)
+{
+  iovec  iov{const_cast<Message*>(&message), sizeof(message)};
+  msghdr msg{};
+  msg.msg_iov    = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  if (fd >= 0) {
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+    auto* cmsg         = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level   = SOL_SOCKET;
+    cmsg->cmsg_type    = SCM_RIGHTS;
+    cmsg->cmsg_len     = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+  return sendmsg(socket, &msg, MSG_NOSIGNAL) ==
+         static_cast<ssize_t>(sizeof(message));
+}
+
+// False once the peer is gone. fd is -1 unless one came along.
+bool receive(int socket, Message& message, int& fd)
+{
+  iovec  iov{&message, sizeof(message)};
+  msghdr msg{};
+  msg.msg_iov    = &iov;
+  msg.msg_iovlen = 1;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  msg.msg_control    = control;
+  msg.msg_controllen = sizeof(control);
+  fd                 = -1;
+  if (recvmsg(socket, &msg, MSG_CMSG_CLOEXEC) !=
+      static_cast<ssize_t>(sizeof(message))) {
+    return false;
+  }
+  for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg       = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+  return true;
+}
+
+}  // namespace wire
+
+// Shared memory both processes have mapped
+struct Segment {
+  uint32_t    id   = 0;
+  void*       data = nullptr;
+  std::size_t size = 0;
+};
+
+/**
+ * Owns one scheduler, and with it the devices, bitstreams and models, for
+ * all processes on the host. Clients connect to a Unix domain socket and
+ * submit tasks by kernel name, their buffers are ranges of shared memory
+ * segments. With a ClBackend, inputs are written to the device straight
+ * from the segment and outputs read back into it, there is no copy in
+ * between. Other backends only schedule, e.g. to test clients with a
+ * SimBackend.
+ */
+class SchedulerDaemon {
+public:
+  SchedulerDaemon(
+      Scheduler& scheduler, const std::string& path = daemon_socket_path())
+    : _scheduler(scheduler)
+    , _path(path)
+    , _cl(dynamic_cast<ClBackend*>(&scheduler.backend()))
+  {
+    _listen = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, _path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(_path.c_str());
+    if (_listen < 0 ||
+        bind(_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+        listen(_listen, 16)) {
+      critical("Cannot listen on {}: {}", _path, std::strerror(errno));
+      std::exit(1);
+    }
+    _acceptor = std::thread(&SchedulerDaemon::accept_loop, this);
+    info("Accepting clients on {}", _path);
+  }
+
+  ~SchedulerDaemon()
+  {
+    shutdown(_listen, SHUT_RDWR);
+    close(_listen);
+    _acceptor.join();
+    {
+      std::lock_guard<std::mutex> lg(_clients_m);
+      for (auto& connection : _connections) {
+        shutdown(connection.first->socket, SHUT_RDWR);
+      }
+    }
+    for (auto& connection : _connections) {
+      connection.second.join();
+    }
+    // Completions still read into the segments of the clients
+    _scheduler.wait();
+    unlink(_path.c_str());
+  }
+
+private:
+  struct Mapping {
+    void*       data = nullptr;
+    std::size_t size = 0;
+  };
+
+  // Lives until its last task finished, even if it disconnects before
+  struct Client {
+    ~Client()
+    {
+      for (auto& segment : segments) {
+        munmap(segment.second.data, segment.second.size);
+      }
+      close(socket);
+    }
+
+    // Never blocks, completions post on the scheduler's queue threads. A
+    // client that stops reading only stalls its own writer.
+    void post(const wire::Message& message)
+    {
+      {
+        std::lock_guard<std::mutex> lg(outbox_m);
+        if (stopped) {
+          return;
+        }
+        outbox.push_back(message);
+      }
+      outbox_cv.notify_one();
+    }
+
+    // Sends the posted messages until stop() or the peer is gone
+    void write_loop()
+    {
+      std::unique_lock<std::mutex> lk(outbox_m);
+      while (true) {
+        outbox_cv.wait(lk, [this]() { return stopped || !outbox.empty(); });
+        if (stopped) {
+          return;
+        }
+        const auto message = outbox.front();
+        outbox.pop_front();
+        lk.unlock();
+        const bool sent = wire::send(socket, message);
+        lk.lock();
+        if (!sent) {
+          stopped = true;
+          outbox.clear();
+        }
+      }
+    }
+
+    // Later messages are dropped
+    void stop()
+    {
+      {
+        std::lock_guard<std::mutex> lg(outbox_m);
+        stopped = true;
+        outbox.clear();
+      }
+      outbox_cv.notify_all();
+    }
+
+    int                         socket = -1;
+    std::atomic<bool>           closed{false};
+    std::map<uint32_t, Mapping> segments;
+    std::mutex                  outbox_m;
+    std::condition_variable     outbox_cv;
+    std::deque<wire::Message>   outbox;
+    bool                        stopped = false;
+  };
+
+  // A client's segments stay mapped while its tasks run, after it is gone
+  using Connection = std::pair<std::shared_ptr<Client>, std::thread>;
+
+  // A task's device buffers, from kernel generation to completion
+  struct Payload {
+    wire::Submit            submit;
+    std::vector<uint8_t*>   host;
+    std::vector<cl::Buffer> buffers;
+    cl::CommandQueue        queue;
+    bool                    generated = false;
+    // Of generating the kernel and staging the inputs
+    cl_int                  status = CL_SUCCESS;
+  };
+
+  void accept_loop()
+  {
+    while (true) {
+      const int socket = accept4(_listen, nullptr, nullptr, SOCK_CLOEXEC);
+      if (socket < 0) {
+        return;
+      }
+      auto client    = std::make_shared<Client>();
+      client->socket = socket;
+      std::lock_guard<std::mutex> lg(_clients_m);
+      reap();
+      _connections.emplace_back(
+          client, std::thread(&SchedulerDaemon::client_loop, this, client));
+    }
+  }
+
+  void client_loop(std::shared_ptr<Client> client)
+  {
+    std::thread   writer(&Client::write_loop, client.get());
+    wire::Message message;
+    int           fd = -1;
+    while (wire::receive(client->socket, message, fd)) {
+      if (message.type == wire::Type::Attach && fd >= 0) {
+        attach(*client, message.attach, fd);
+      } else if (message.type == wire::Type::Submit) {
+        submit(client, message.submit);
+      }
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    debug("Client {} disconnected", client->socket);
+    client->stop();
+    writer.join();
+    client->closed = true;
+  }
+
+  // Joins the threads of clients that are gone, requires _clients_m
+  void reap()
+  {
+    auto gone = std::partition(
+        _connections.begin(), _connections.end(), [](const auto& c) {
+          return !c.first->closed;
+        });
+    for (auto it = gone; it != _connections.end(); it++) {
+      it->second.join();
+    }
+    _connections.erase(gone, _connections.end());
+  }
+
+  // Only sealed against shrinking, a segment that shrinks while it is
+  // mapped would fault the daemon on its next access
+  void attach(Client& client, const wire::Attach& attach, int fd)
+  {
+    struct stat st {};
+    if (client.segments.count(attach.segment)) {
+      warn("Rejecting segment {}: attached before", attach.segment);
+      return;
+    }
+    if (fstat(fd, &st) || attach.size == 0 ||
+        attach.size > static_cast<uint64_t>(st.st_size) ||
+        !(fcntl(fd, F_GET_SEALS) & F_SEAL_SHRINK)) {
+      warn("Rejecting segment {}: unsealed or too small", attach.segment);
+      return;
+    }
+    void* data = mmap(
+        nullptr, attach.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      warn("Cannot map segment {}: {}", attach.segment, std::strerror(errno));
+      return;
+    }
+    client.segments[attach.segment] = {data, attach.size};
+  }
+
+  // The kernel has to be in a loaded configuration, every other name
+  // would get a queue of its own
+  bool known_kernel(const wire::Submit& submit) const
+  {
+    const auto& configs = _scheduler.configs();
+    if (submit.config[0] != '\0') {
+      return std::find(configs.begin(), configs.end(), submit.config) !=
+                 configs.end() &&
+             has_kernel_params(submit.config, submit.kernel);
+    }
+    return std::any_of(
+        configs.begin(), configs.end(), [&submit](const std::string& c) {
+          return has_kernel_params(c, submit.kernel);
+        });
+  }
+
+  // Host pointers of the buffer arguments, false if one is out of bounds
+  static bool resolve(const Client& client, Payload& payload)
+  {
+    const auto& submit = payload.submit;
+    payload.host.assign(submit.args, nullptr);
+    for (uint32_t i = 0; i < submit.args; i++) {
+      const auto& arg = submit.arg[i];
+      if (arg.kind == wire::ArgKind::Scalar) {
+        if (arg.size > sizeof(arg.scalar)) {
+          return false;
+        }
+        continue;
+      }
+      auto it = client.segments.find(arg.segment);
+      if (it == client.segments.end() || arg.offset > it->second.size ||
+          arg.size > it->second.size - arg.offset) {
+        return false;
+      }
+      payload.host[i] = static_cast<uint8_t*>(it->second.data) + arg.offset;
+    }
+    return true;
+  }
+
+  void submit(const std::shared_ptr<Client>& client, wire::Submit& submit)
+  {
+    submit.kernel[wire::name_size - 1] = '\0';
+    submit.config[wire::name_size - 1] = '\0';
+    auto payload    = std::make_shared<Payload>();
+    payload->submit = submit;
+    if (submit.dims > 3 || submit.args > wire::max_args ||
+        !resolve(*client, *payload)) {
+      warn("Rejecting malformed task {} ({})", submit.kernel, submit.tag);
+      reply(*client, submit.tag, CL_INVALID_VALUE, 0);
+      return;
+    }
+    if (!known_kernel(submit)) {
+      warn("Rejecting task of unknown kernel {}", submit.kernel);
+      reply(*client, submit.tag, CL_INVALID_KERNEL_NAME, 0);
+      return;
+    }
+
+    Task task(
+        submit.kernel,
+        _cl ? kernel_gen(payload) : KernelGen{},
+        dims(submit));
+    if (submit.problem_size > 0) {
+      task.set_problem_size(submit.problem_size);
+    }
+    if (submit.config[0] != '\0') {
+      task.set_config(submit.config);
+    }
+    task.set_priority(submit.priority);
+    if (submit.deadline_ns > 0) {
+      task.set_deadline(
+          Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                             std::chrono::nanoseconds(submit.deadline_ns)));
+    }
+    std::size_t bytes = 0;
+    for (uint32_t i = 0; i < submit.args; i++) {
+      bytes += submit.arg[i].kind == wire::ArgKind::Scalar
+                   ? 0
+                   : submit.arg[i].size;
+    }
+    task.set_transfer_bytes(bytes);
+    task.set_completion([client, payload](const Task& t) {
+      auto status = payload->status;
+      if (status == CL_SUCCESS) {
+        status = t.status();
+      }
+      if (status == CL_SUCCESS) {
+        status = collect(*payload);
+      }
+      const std::chrono::duration<double> took =
+          t.finished_at() - t.started_at();
+      reply(*client, payload->submit.tag, status, took.count());
+    });
+
+    bool accepted = false;
+    {
+      // All clients share the scheduler
+      std::lock_guard<std::mutex> lg(_submit_m);
+      accepted = _scheduler.add_task(std::move(task));
+    }
+    if (!accepted) {
+      reply(*client, submit.tag, CL_INVALID_OPERATION, 0);
+    }
+  }
+
+  static TaskDims dims(const wire::Submit& submit)
+  {
+    auto range = [&submit](const uint64_t* e) {
+      switch (submit.dims) {
+        case 1: return cl::NDRange(e[0]);
+        case 2: return cl::NDRange(e[0], e[1]);
+        case 3: return cl::NDRange(e[0], e[1], e[2]);
+        default: return cl::NDRange(1);
+      }
+    };
+    TaskDims d(range(submit.global));
+    if (submit.local[0] > 0) {
+      d.local = range(submit.local);
+    }
+    if (submit.dims > 0 && submit.offset[0] + submit.offset[1] +
+                                   submit.offset[2] > 0) {
+      d.offset = range(submit.offset);
+    }
+    return d;
+  }
+
+  // Writes the inputs from the client's segments to fresh device buffers.
+  // Errors, e.g. of a wrong argument count or scalar size, only fail the
+  // task: the invalid kernel makes the stream skip it.
+  static KernelGen kernel_gen(std::shared_ptr<Payload> payload)
+  {
+    return [payload](const cl::Program& prg, const std::string& name) {
+      auto&      p   = *payload;
+      const auto ctx = prg.getInfo<CL_PROGRAM_CONTEXT>();
+      cl::Kernel kernel(prg, name.c_str(), &p.status);
+      p.queue = cl::CommandQueue(ctx);
+      p.buffers.assign(p.submit.args, cl::Buffer());
+      for (uint32_t i = 0; i < p.submit.args && p.status == CL_SUCCESS;
+           i++) {
+        const auto& arg = p.submit.arg[i];
+        if (arg.kind == wire::ArgKind::Scalar) {
+          p.status = kernel.setArg(i, arg.size, arg.scalar);
+          continue;
+        }
+        p.buffers[i] =
+            cl::Buffer(ctx, CL_MEM_READ_WRITE, arg.size, nullptr, &p.status);
+        if (p.status == CL_SUCCESS && arg.kind != wire::ArgKind::Output) {
+          p.status = p.queue.enqueueWriteBuffer(
+              p.buffers[i], CL_TRUE, 0, arg.size, p.host[i]);
+        }
+        if (p.status == CL_SUCCESS) {
+          p.status = kernel.setArg(i, p.buffers[i]);
+        }
+      }
+      if (p.status != CL_SUCCESS) {
+        warn(
+            "Cannot launch {} for a client: {}",
+            name,
+            clGetErrorString(p.status));
+        p.buffers.clear();
+        return cl::Kernel();
+      }
+      p.generated = true;
+      return kernel;
+    };
+  }
+
+  // Reads the outputs back into the client's segments
+  static cl_int collect(Payload& p)
+  {
+    cl_int status = CL_SUCCESS;
+    if (!p.generated) {
+      return status;
+    }
+    for (uint32_t i = 0; i < p.submit.args && status == CL_SUCCESS; i++) {
+      const auto& arg = p.submit.arg[i];
+      if (arg.kind == wire::ArgKind::Output ||
+          arg.kind == wire::ArgKind::InOut) {
+        status = p.queue.enqueueReadBuffer(
+            p.buffers[i], CL_TRUE, 0, arg.size, p.host[i]);
+      }
+    }
+    p.buffers.clear();
+    return status;
+  }
+
+  static void reply(Client& client, uint64_t tag, int32_t status, double s)
+  {
+    wire::Message message;
+    message.type = wire::Type::Done;
+    message.done = {tag, status, s};
+    client.post(message);
+  }
+
+  Scheduler&                           _scheduler;
+  std::string                          _path;
+  ClBackend*                           _cl;
+  int                                  _listen = -1;
+  std::mutex                           _submit_m;
+  std::mutex                           _clients_m;
+  std::vector<Connection>              _connections;
+  std::thread                          _acceptor;
+};
+
+// A task for the daemon, built up argument by argument
+struct RemoteTask {
+  RemoteTask(const std::string& kernel, TaskDims dims = TaskDims())
+  {
+    std::strncpy(submit.kernel, kernel.c_str(), wire::name_size - 1);
+    submit.priority = Priority::Normal;
+    submit.dims     = dims.global.dimensions();
+    for (std::size_t d = 0; d < submit.dims; d++) {
+      submit.global[d] = dims.global[d];
+      if (dims.local.dimensions() > d) {
+        submit.local[d] = dims.local[d];
+      }
+      if (dims.offset.dimensions() > d) {
+        submit.offset[d] = dims.offset[d];
+      }
+    }
+  }
+
+  template <typename T>
+  RemoteTask& scalar(const T& value)
+  {
+    static_assert(sizeof(T) <= sizeof(wire::Arg::scalar), "Scalar too big");
+    auto& arg = next();
+    arg.kind  = wire::ArgKind::Scalar;
+    arg.size  = sizeof(T);
+    std::memcpy(arg.scalar, &value, sizeof(T));
+    return *this;
+  }
+
+  // Bytes of the segment from offset on
+  RemoteTask& buffer(
+      wire::ArgKind      kind,
+      const Segment&     segment,
+      std::size_t        offset,
+      std::size_t        size)
+  {
+    auto& arg   = next();
+    arg.kind    = kind;
+    arg.segment = segment.id;
+    arg.offset  = offset;
+    arg.size    = size;
+    return *this;
+  }
+
+  RemoteTask& config(const std::string& bitstream)
+  {
+    std::strncpy(submit.config, bitstream.c_str(), wire::name_size - 1);
+    return *this;
+  }
+
+  RemoteTask& problem_size(std::size_t size)
+  {
+    submit.problem_size = size;
+    return *this;
+  }
+
+  RemoteTask& priority(Priority priority)
+  {
+    submit.priority = priority;
+    return *this;
+  }
+
+  RemoteTask& deadline(std::chrono::nanoseconds from_now)
+  {
+    submit.deadline_ns = from_now.count();
+    return *this;
+  }
+
+  wire::Submit submit{};
+
+private:
+  wire::Arg& next()
+  {
+    assert(submit.args < wire::max_args);
+    return submit.arg[submit.args++];
+  }
+};
+
+/**
+ * Connection of a process to the daemon. Not thread-safe, every thread
+ * that submits has a client of its own.
+ */
+class DaemonClient {
+public:
+  explicit DaemonClient(const std::string& path = daemon_socket_path())
+  {
+    _socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (_socket < 0 ||
+        connect(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+      critical("Cannot connect to {}: {}", path, std::strerror(errno));
+      std::exit(1);
+    }
+  }
+
+  DaemonClient(const DaemonClient&) = delete;
+  DaemonClient& operator=(const DaemonClient&) = delete;
+
+  ~DaemonClient()
+  {
+    close(_socket);
+    for (auto& segment : _segments) {
+      munmap(segment.data, segment.size);
+    }
+  }
+
+  // Shared memory for buffer arguments, mapped by the daemon as well
+  // Sealed against shrinking, the daemon rejects it otherwise
+  const Segment& allocate(std::size_t size)
+  {
+    const int fd = memfd_create("forecast", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0 || ftruncate(fd, size) ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL)) {
+      critical("Cannot create a segment: {}", std::strerror(errno));
+      std::exit(1);
+    }
+    Segment segment;
+    segment.id   = static_cast<uint32_t>(_segments.size());
+    segment.size = size;
+    segment.data =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (segment.data == MAP_FAILED) {
+      critical("Cannot map a segment: {}", std::strerror(errno));
+      std::exit(1);
+    }
+    wire::Message message;
+    message.type   = wire::Type::Attach;
+    message.attach = {segment.id, size};
+    wire::send(_socket, message, fd);
+    close(fd);
+    _segments.push_back(segment);
+    return _segments.back();
+  }
+
+  // Returns the tag the completion carries
+  uint64_t submit(RemoteTask& task)
+  {
+    task.submit.tag = _next_tag++;
+    wire::Message message;
+    message.type   = wire::Type::Submit;
+    message.submit = task.submit;
+    wire::send(_socket, message);
+    _outstanding++;
+    return task.submit.tag;
+  }
+
+  // Blocks for the next completion, status is CL_SUCCESS if the task ran
+  wire::Done next()
+  {
+    wire::Message message;
+    int           fd = -1;
+    while (wire::receive(_socket, message, fd)) {
+      if (message.type == wire::Type::Done) {
+        _outstanding--;
+        return message.done;
+      }
+    }
+    _outstanding = 0;
+    return {0, CL_DEVICE_NOT_AVAILABLE, 0};
+  }
+
+  // Until every submitted task completed, returns how many failed
+  std::size_t wait()
+  {
+    std::size_t failed = 0;
+    while (_outstanding > 0) {
+      failed += next().status != CL_SUCCESS;
+    }
+    return failed;
+  }
+
+private:
+  int                 _socket = -1;
+  uint64_t            _next_tag    = 0;
+  std::size_t         _outstanding = 0;
+  std::deque<Segment> _segments;
+};
+
+}  // namespace forecast
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "parameters.h"
+#include "task.h"
+
+#include <CL/cl.hpp>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace forecast {
+
+/**
+ * How the scheduler resizes the tasks of a kernel, see
+ * Scheduler::set_granularity. Tasks predicted to take longer than twice
+ * chunk_seconds are split into sub-ranges of about chunk_seconds along the
+ * last dimension of their global range, so other work can run in between.
+ * Adjacent waiting tasks with the same coalesce key are launched as one
+ * while that stays below chunk_seconds. Only for NDRange kernels that
+ * index by get_global_id, which includes the global offset, and do not
+ * depend on the global size of the last dimension. Kernels that index by
+ * get_group_id, like matrixMult, or single work-item kernels, like
+ * vector_triad1, compute the wrong elements on a sub-range. The caller
+ * states that the kernel is safe with offset_safe, set_granularity leaves
+ * the kernel's tasks alone without it.
+ */
+struct Granularity {
+  double      chunk_seconds = 0.005;
+  std::size_t max_chunks    = 64;
+  bool        split         = true;
+  bool        coalesce      = true;
+  bool        offset_safe   = false;
+};
+
+std::array<std::size_t, 3> extents(const cl::NDRange& range)
+{
+  std::array<std::size_t, 3> e{0, 0, 0};
+  for (std::size_t d = 0; d < range.dimensions(); d++) {
+    e[d] = range[d];
+  }
+  return e;
+}
+
+cl::NDRange ndrange(std::size_t dims, const std::array<std::size_t, 3>& e)
+{
+  switch (dims) {
+    case 0: return cl::NullRange;
+    case 1: return cl::NDRange(e[0]);
+    case 2: return cl::NDRange(e[0], e[1]);
+    default: return cl::NDRange(e[0], e[1], e[2]);
+  }
+}
+
+// Smallest problem size with at least the given FLOPs, at most limit, so
+// that sub-ranges keep their share of the work for kernels whose FLOPs grow
+// faster than their size, e.g. matrixMult. Kernels without a FLOP formula
+// get fallback.
+std::size_t size_for_flop(
+    const KernelParams& params,
+    double              flop,
+    std::size_t         limit,
+    std::size_t         fallback)
+{
+  if (flop <= 0) {
+    return std::max<std::size_t>(1, fallback);
+  }
+  std::size_t low = 1, high = std::max<std::size_t>(1, limit);
+  while (low < high) {
+    const auto mid = low + (high - low) / 2;
+    if (params.flop(mid) < flop) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+ * Splits the task into at most chunks sub-ranges along the last dimension,
+ * at multiples of its local size. The chunks keep the kernel, placement
+ * and ordering of the task, the first one carries its transfers.
+ */
+std::vector<Task> split_task(
+    Task& task, std::size_t chunks, const KernelParams& params)
+{
+  std::vector<Task> parts;
+  const auto        dims = task.global().dimensions();
+  if (dims == 0) {
+    return parts;
+  }
+  const auto last    = dims - 1;
+  const auto global  = extents(task.global());
+  const auto offset  = extents(task.offset());
+  const auto granule = task.has_local() ? task.local()[last] : 1;
+  const auto units   = global[last] / std::max<std::size_t>(1, granule);
+  chunks             = std::min(chunks, units);
+  if (chunks < 2) {
+    return parts;
+  }
+
+  const auto total = params.flop(task.problem_size());
+  // Backlog of the parts before chunk, which end at at. The last part takes
+  // the rest, so that they add up to the task's.
+  auto backlog = [&](std::size_t chunk, std::size_t at) {
+    return chunk == chunks
+               ? task.backlog_ns()
+               : static_cast<int64_t>(
+                     static_cast<double>(task.backlog_ns()) * at /
+                     global[last]);
+  };
+  parts.reserve(chunks);
+  for (std::size_t i = 0; i < chunks; i++) {
+    const auto begin = i * units / chunks * granule;
+    const auto end   = (i + 1) * units / chunks * granule;
+    auto       g     = global;
+    auto       o     = offset;
+    g[last]          = end - begin;
+    o[last] += begin;
+    const double share = static_cast<double>(g[last]) / global[last];
+
+    TaskDims d(ndrange(dims, g), task.local());
+    d.offset = ndrange(dims, o);
+    parts.emplace_back(task.interned_name(), task.kernel_gen(), d);
+    auto& part = parts.back();
+    part.set_problem_size(size_for_flop(
+        params,
+        total * share,
+        task.problem_size(),
+        task.problem_size() * share));
+    part.set_transfer_bytes(i == 0 ? task.transfer_bytes() : 0);
+    part.set_coalesce_key(task.coalesce_key());
+    part.set_priority(task.priority());
+    part.set_deadline(task.deadline());
+    part.set_predicted(task.predicted() * share);
+    part.set_backlog_ns(backlog(i + 1, end) - backlog(i, begin));
+    if (task.config()) {
+      part.set_config(*task.config());
+    }
+  }
+  return parts;
+}
+
+// Whether next continues the range of task on the same buffers
+bool can_coalesce(const Task& task, const Task& next)
+{
+  const auto dims = task.global().dimensions();
+  if (task.coalesce_key() == 0 || task.completion() || next.completion() ||
+      task.coalesce_key() != next.coalesce_key() ||
+      task.interned_name() != next.interned_name() ||
+      task.config() != next.config() ||
+      task.priority() != next.priority() || dims == 0 ||
+      dims != next.global().dimensions() ||
+      extents(task.local()) != extents(next.local())) {
+    return false;
+  }
+  const auto g = extents(task.global()), ng = extents(next.global());
+  const auto o = extents(task.offset()), no = extents(next.offset());
+  for (std::size_t d = 0; d + 1 < dims; d++) {
+    if (g[d] != ng[d] || o[d] != no[d]) {
+      return false;
+    }
+  }
+  return no[dims - 1] == o[dims - 1] + g[dims - 1];
+}
+
+// Extends task by next, which has to pass can_coalesce
+void coalesce(Task& task, const Task& next, const KernelParams& params)
+{
+  const auto dims = task.global().dimensions();
+  auto       g    = extents(task.global());
+  const auto flop =
+      params.flop(task.problem_size()) + params.flop(next.problem_size());
+  const auto limit = task.problem_size() + next.problem_size();
+  g[dims - 1] += next.global()[dims - 1];
+
+  TaskDims d(ndrange(dims, g), task.local());
+  d.offset = task.offset();
+  task.set_dims(d);
+  task.set_problem_size(size_for_flop(params, flop, limit, limit));
+  task.set_transfer_bytes(task.transfer_bytes() + next.transfer_bytes());
+  task.set_deadline(std::min(task.deadline(), next.deadline()));
+  task.set_predicted(task.predicted() + next.predicted());
+  task.set_merged(task.merged() + next.merged());
+  task.set_backlog_ns(task.backlog_ns() + next.backlog_ns());
+}
+
+}  // namespace forecast
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "model.h"
+#include "queue.h"
+#include "task.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace forecast {
+
+// Kernel a task ran next to for the largest part of its run
+struct CoRun {
+  const std::string* other = nullptr;
+  // Share of the task's run, 0 if it ran alone
+  double overlap = 0;
+};
+
+// Learned slowdown of a kernel while another one runs
+using SlowdownLookup =
+    std::function<Slowdown(const std::string&, const std::string&)>;
+
+/**
+ * Lets kernels of the loaded bitstream share the device only if that pays
+ * off. Two kernels that run together progress at 1 / slowdown of their own
+ * speed each, so a pair is worth co-running as long as the sum of both rates
+ * exceeds one. Pairs with fewer than min_samples measurements co-run to
+ * learn their slowdowns. When a compute unit frees up, the waiting kernel
+ * that pairs best with the running ones gets it, an idle device goes to the
+ * kernel that waits longest. A kernel that has been passed over max_bypass
+ * times or has waited max_wait seconds is next regardless: it starts next
+ * to the running kernels if it pairs well with them, otherwise nothing
+ * else starts until it can run alone.
+ */
+class CoScheduler : public LaunchGate {
+public:
+  CoScheduler(
+      unsigned       units,
+      SlowdownLookup slowdown,
+      uint64_t       min_samples = 3,
+      unsigned       max_bypass  = 8,
+      double         max_wait    = 0.05)
+    : _units(units)
+    , _slowdown(std::move(slowdown))
+    , _min_samples(min_samples)
+    , _max_bypass(max_bypass)
+    , _max_wait(max_wait)
+  {
+  }
+
+  void acquire(const Task& task) override
+  {
+    std::unique_lock<std::mutex> lk(_m);
+    const auto ticket = _next_ticket++;
+    _waiting.push_back({task.interned_name(), ticket, Clock::now()});
+    schedule();
+    _cv.wait(lk, [this, ticket]() { return _granted.count(ticket) > 0; });
+    _granted.erase(ticket);
+  }
+
+  void release(const Task& task) override
+  {
+    {
+      std::lock_guard<std::mutex> lg(_m);
+      const auto now = Clock::now();
+      advance(now);
+      auto it = std::find_if(
+          _running.begin(), _running.end(), [&task](const Running& r) {
+            return r.kernel == task.interned_name();
+          });
+      assert(it != _running.end());
+      const std::chrono::duration<double> total = now - it->since;
+      CoRun                               corun;
+      for (const auto& other : it->overlap) {
+        const auto share = other.second / total.count();
+        if (total.count() > 0 && share > corun.overlap) {
+          corun = {other.first, share};
+        }
+      }
+      _coruns[it->kernel] = corun;
+      _running.erase(it);
+      schedule();
+    }
+    _cv.notify_all();
+  }
+
+  // Of the kernel's last finished task, valid until it launches again
+  CoRun corun(const std::string* kernel) const
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    auto it = _coruns.find(kernel);
+    return it == _coruns.end() ? CoRun{} : it->second;
+  }
+
+  // Sum of the progress rates of a and b while they run together, unknown
+  // pairs are assumed to gain
+  double pair_gain(const std::string& a, const std::string& b) const
+  {
+    const auto ab = _slowdown(a, b);
+    const auto ba = _slowdown(b, a);
+    if (ab.n < _min_samples || ba.n < _min_samples) {
+      return 2;
+    }
+    return 1 / std::max(ab.mean, 1e-9) + 1 / std::max(ba.mean, 1e-9);
+  }
+
+private:
+  struct Waiting {
+    const std::string* kernel;
+    uint64_t           ticket;
+    TimePoint          since;
+    // Times a younger kernel started first
+    unsigned           bypassed = 0;
+  };
+
+  struct Running {
+    const std::string*                   kernel;
+    TimePoint                            since;
+    // Seconds next to each other kernel
+    std::map<const std::string*, double> overlap;
+  };
+
+  // Requires _m
+  void advance(TimePoint now)
+  {
+    const std::chrono::duration<double> elapsed = now - _last;
+    _last                                       = now;
+    if (_running.size() < 2) {
+      return;
+    }
+    for (auto& r : _running) {
+      for (const auto& other : _running) {
+        if (other.kernel != r.kernel) {
+          r.overlap[other.kernel] += elapsed.count();
+        }
+      }
+    }
+  }
+
+  // Requires _m. Gain of the kernel with the worst partner among the
+  // running ones.
+  double running_gain(const std::string& kernel) const
+  {
+    double gain = std::numeric_limits<double>::max();
+    for (const auto& r : _running) {
+      gain = std::min(gain, pair_gain(kernel, *r.kernel));
+    }
+    return gain;
+  }
+
+  // Requires _m, grants waiting kernels as long as units are free
+  void schedule()
+  {
+    bool granted = false;
+    while (_running.size() < _units && !_waiting.empty()) {
+      // Tickets are handed out in order, the first one waits longest
+      const auto                          now    = Clock::now();
+      const auto                          oldest = _waiting.begin();
+      const std::chrono::duration<double> waited = now - oldest->since;
+      const bool starving =
+          oldest->bypassed >= _max_bypass || waited.count() >= _max_wait;
+
+      auto pick = _waiting.end();
+      if (_running.empty()) {
+        pick = oldest;
+      } else if (starving) {
+        if (running_gain(*oldest->kernel) > 1) {
+          pick = oldest;
+        }
+      } else {
+        double best = 1;
+        for (auto it = _waiting.begin(); it != _waiting.end(); it++) {
+          const auto gain = running_gain(*it->kernel);
+          if (gain > best) {
+            best = gain;
+            pick = it;
+          }
+        }
+      }
+      if (pick == _waiting.end()) {
+        break;
+      }
+      for (auto it = _waiting.begin(); it != pick; it++) {
+        it->bypassed++;
+      }
+      advance(now);
+      _running.push_back({pick->kernel, now, {}});
+      _granted.insert(pick->ticket);
+      _waiting.erase(pick);
+      granted = true;
+    }
+    if (granted) {
+      _cv.notify_all();
+    }
+  }
+
+  unsigned                            _units;
+  SlowdownLookup                      _slowdown;
+  uint64_t                            _min_samples;
+  unsigned                            _max_bypass;
+  double                              _max_wait;
+  mutable std::mutex                  _m;
+  std::condition_variable             _cv;
+  uint64_t                            _next_ticket = 0;
+  std::list<Waiting>                  _waiting;
+  std::set<uint64_t>                  _granted;
+  std::list<Running>                  _running;
+  TimePoint                           _last = Clock::now();
+  std::map<const std::string*, CoRun> _coruns;
+};
+
+}  // namespace forecast
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace forecast {
+
+struct HistogramSnapshot {
+  std::vector<uint64_t> counts;
+  uint64_t              count = 0;
+  uint64_t              sum   = 0;
+
+  // Value below which the fraction p of the recorded values lies
+  double percentile(double p) const;
+
+  double mean() const
+  {
+    return count > 0 ? static_cast<double>(sum) / count : 0;
+  }
+};
+
+/**
+ * Log-linear histogram in the style of HdrHistogram. Values below 16 are
+ * exact, above that every power of two is split into 16 buckets, which
+ * bounds the relative error by 1/16. Recording is a relaxed increment, so
+ * any thread may record while another one takes a snapshot.
+ */
+class Histogram {
+public:
+  static constexpr unsigned    sub_bits    = 4;
+  static constexpr unsigned    sub_buckets = 1 << sub_bits;
+  static constexpr std::size_t buckets     = (64 - sub_bits + 1) * sub_buckets;
+
+  static std::size_t bucket(uint64_t value)
+  {
+    if (value < sub_buckets) {
+      return value;
+    }
+    const unsigned shift = 63 - __builtin_clzll(value) - sub_bits;
+    return (shift + 1) * sub_buckets + ((value >> shift) & (sub_buckets - 1));
+  }
+
+  static uint64_t lower_bound(std::size_t bucket)
+  {
+    if (bucket < sub_buckets) {
+      return bucket;
+    }
+    const unsigned shift = bucket / sub_buckets - 1;
+    return static_cast<uint64_t>(sub_buckets + bucket % sub_buckets) << shift;
+  }
+
+  void record(uint64_t value)
+  {
+    _counts[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  // Durations are recorded in nanoseconds
+  template <typename Rep, typename Period>
+  void record(std::chrono::duration<Rep, Period> duration)
+  {
+    const auto ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    record(static_cast<uint64_t>(ns > 0 ? ns : 0));
+  }
+
+  HistogramSnapshot snapshot() const
+  {
+    HistogramSnapshot s;
+    s.counts.resize(buckets);
+    for (std::size_t i = 0; i < buckets; i++) {
+      s.counts[i] = _counts[i].load(std::memory_order_relaxed);
+      s.count += s.counts[i];
+    }
+    s.sum = _sum.load(std::memory_order_relaxed);
+    return s;
+  }
+
+  void reset()
+  {
+    for (auto& count : _counts) {
+      count.store(0, std::memory_order_relaxed);
+    }
+    _sum.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, buckets> _counts{};
+  std::atomic<uint64_t>                      _sum{0};
+};
+
+double HistogramSnapshot::percentile(double p) const
+{
+  if (count == 0) {
+    return 0;
+  }
+  const auto rank = static_cast<uint64_t>(p * (count - 1)) + 1;
+  uint64_t   seen = 0;
+  for (std::size_t i = 0; i < counts.size(); i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      // Middle of the bucket
+      const auto low  = Histogram::lower_bound(i);
+      const auto high = i + 1 < counts.size() ? Histogram::lower_bound(i + 1)
+                                              : low + 1;
+      return low + (high - low - 1) / 2.0;
+    }
+  }
+  return Histogram::lower_bound(counts.size() - 1);
+}
+
+struct KernelMetrics {
+  std::atomic<uint64_t> submitted{0};
+  std::atomic<uint64_t> completed{0};
+  // Tasks submitted but not finished yet
+  std::atomic<int64_t> depth{0};
+  // Finished tasks with a deadline, those that missed it and those that
+  // admission turned away
+  std::atomic<uint64_t> deadlines{0};
+  std::atomic<uint64_t> deadline_misses{0};
+  std::atomic<uint64_t> rejected{0};
+  // Nanoseconds from submission to launch, on the device and in callbacks
+  Histogram queue_wait;
+  Histogram device;
+  Histogram callback;
+  // |predicted - actual| / actual of the online model, parts per million
+  Histogram model_error;
+
+  void reset()
+  {
+    submitted.store(0, std::memory_order_relaxed);
+    completed.store(0, std::memory_order_relaxed);
+    deadlines.store(0, std::memory_order_relaxed);
+    deadline_misses.store(0, std::memory_order_relaxed);
+    rejected.store(0, std::memory_order_relaxed);
+    queue_wait.reset();
+    device.reset();
+    callback.reset();
+    model_error.reset();
+  }
+};
+
+struct ConfigMetrics {
+  std::atomic<uint64_t> completed{0};
+  // Switches to this configuration
+  std::atomic<uint64_t> reconfigurations{0};
+
+  void reset()
+  {
+    completed.store(0, std::memory_order_relaxed);
+    reconfigurations.store(0, std::memory_order_relaxed);
+  }
+};
+
+struct KernelSnapshot {
+  uint64_t          submitted       = 0;
+  uint64_t          completed       = 0;
+  int64_t           depth           = 0;
+  uint64_t          deadlines       = 0;
+  uint64_t          deadline_misses = 0;
+  uint64_t          rejected        = 0;
+  HistogramSnapshot queue_wait;
+  HistogramSnapshot device;
+  HistogramSnapshot callback;
+  HistogramSnapshot model_error;
+};
+
+struct ConfigSnapshot {
+  uint64_t completed        = 0;
+  uint64_t reconfigurations = 0;
+};
+
+struct MetricsSnapshot {
+  std::map<std::string, KernelSnapshot> kernels;
+  std::map<std::string, ConfigSnapshot> configs;
+
+  uint64_t reconfigurations() const
+  {
+    uint64_t total = 0;
+    for (const auto& config : configs) {
+      total += config.second.reconfigurations;
+    }
+    return total;
+  }
+};
+
+/**
+ * Counters of a scheduler. Looking up a kernel or configuration takes a
+ * lock, the returned metrics stay valid for the lifetime of the registry
+ * and are updated without one.
+ */
+class Metrics {
+public:
+  KernelMetrics& kernel(const std::string& name)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    auto& metrics = _kernels[name];
+    if (!metrics) {
+      metrics = std::make_unique<KernelMetrics>();
+    }
+    return *metrics;
+  }
+
+  ConfigMetrics& config(const std::string& name)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    auto& metrics = _configs[name];
+    if (!metrics) {
+      metrics = std::make_unique<ConfigMetrics>();
+    }
+    return *metrics;
+  }
+
+  MetricsSnapshot snapshot() const
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    MetricsSnapshot             s;
+    for (const auto& kernel : _kernels) {
+      const auto& k  = *kernel.second;
+      auto&       ks = s.kernels[kernel.first];
+      ks.submitted   = k.submitted.load(std::memory_order_relaxed);
+      ks.completed   = k.completed.load(std::memory_order_relaxed);
+      ks.depth       = k.depth.load(std::memory_order_relaxed);
+      ks.deadlines   = k.deadlines.load(std::memory_order_relaxed);
+      ks.deadline_misses =
+          k.deadline_misses.load(std::memory_order_relaxed);
+      ks.rejected    = k.rejected.load(std::memory_order_relaxed);
+      ks.queue_wait  = k.queue_wait.snapshot();
+      ks.device      = k.device.snapshot();
+      ks.callback    = k.callback.snapshot();
+      ks.model_error = k.model_error.snapshot();
+    }
+    for (const auto& config : _configs) {
+      auto& cs     = s.configs[config.first];
+      cs.completed = config.second->completed.load(std::memory_order_relaxed);
+      cs.reconfigurations =
+          config.second->reconfigurations.load(std::memory_order_relaxed);
+    }
+    return s;
+  }
+
+  // Clears counters and histograms, depth gauges keep their value
+  void reset()
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    for (auto& kernel : _kernels) {
+      kernel.second->reset();
+    }
+    for (auto& config : _configs) {
+      config.second->reset();
+    }
+  }
+
+private:
+  mutable std::mutex                                    _m;
+  std::map<std::string, std::unique_ptr<KernelMetrics>> _kernels;
+  std::map<std::string, std::unique_ptr<ConfigMetrics>> _configs;
+};
+
+}  // namespace forecast
@@ -3,8 +3,13 @@
 #include "task.h"
 #include "parameters.h"
 
-#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <numeric>
+#include <utility>
 
 namespace forecast {
 class Queue;
@@ -19,6 +24,227 @@ struct Parameters {
   double beta = 1.0;
 };
 
+template <typename T>
+void write_pod(std::ostream &out, const T &value)
+{
+  out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+void read_pod(std::istream &in, T &value)
+{
+  in.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+void write_string(std::ostream &out, const std::string &str)
+{
+  write_pod(out, static_cast<uint32_t>(str.size()));
+  out.write(str.data(), str.size());
+}
+
+std::string read_string(std::istream &in)
+{
+  uint32_t size = 0;
+  read_pod(in, size);
+  // Names are short, anything else is a corrupt file
+  if (size > (1 << 16)) {
+    in.setstate(std::ios::failbit);
+    return {};
+  }
+  std::string str(size, '\0');
+  in.read(std::addressof(str[0]), size);
+  return str;
+}
+
+/**
+ * Sufficient statistics of a series of measurements for the regressions in
+ * Model. Updated online (Welford), so no samples are kept.
+ */
+struct Statistics {
+  void add(const Measurement &m) {
+    n++;
+    const double dx = m.x - mean_x;
+    mean_x += dx / n;
+    mean_y += (m.y - mean_y) / n;
+    m2_x += dx * (m.x - mean_x);
+    c_xy += dx * (m.y - mean_y);
+  }
+
+  double sum_xx() const {
+    return m2_x + n * mean_x * mean_x;
+  }
+
+  double sum_xy() const {
+    return c_xy + n * mean_x * mean_y;
+  }
+
+  void save(std::ostream &out) const {
+    write_pod(out, n);
+    write_pod(out, mean_x);
+    write_pod(out, mean_y);
+    write_pod(out, m2_x);
+    write_pod(out, c_xy);
+  }
+
+  void load(std::istream &in) {
+    read_pod(in, n);
+    read_pod(in, mean_x);
+    read_pod(in, mean_y);
+    read_pod(in, m2_x);
+    read_pod(in, c_xy);
+  }
+
+  uint64_t n      = 0;
+  double   mean_x = 0;
+  double   mean_y = 0;
+  // sum (x - mean_x)^2
+  double m2_x = 0;
+  // sum (x - mean_x) * (y - mean_y)
+  double c_xy = 0;
+};
+
+/**
+ * Streaming estimate of the p-quantile of a series with the P² algorithm
+ * (Jain and Chlamtac): five markers whose heights follow the quantile
+ * with piecewise parabolic interpolation. Constant memory, exact for the
+ * first five values.
+ */
+class P2Quantile {
+public:
+  explicit P2Quantile(double p = 0.5)
+    : _p(p)
+    , _want{1, 1 + 2 * p, 1 + 4 * p, 3 + 2 * p, 5}
+  {
+  }
+
+  void add(double x) {
+    if (_n < 5) {
+      _q[_n++] = x;
+      std::sort(_q, _q + _n);
+      return;
+    }
+    int k = 0;
+    if (x < _q[0]) {
+      _q[0] = x;
+    } else if (x >= _q[4]) {
+      _q[4] = x;
+      k     = 3;
+    } else {
+      while (x >= _q[k + 1]) {
+        k++;
+      }
+    }
+    for (int i = k + 1; i < 5; i++) {
+      _pos[i]++;
+    }
+    const double increment[5] = {0, _p / 2, _p, (1 + _p) / 2, 1};
+    for (int i = 0; i < 5; i++) {
+      _want[i] += increment[i];
+    }
+    _n++;
+
+    for (int i = 1; i < 4; i++) {
+      const auto d = _want[i] - _pos[i];
+      if ((d >= 1 && _pos[i + 1] - _pos[i] > 1) ||
+          (d <= -1 && _pos[i - 1] - _pos[i] < -1)) {
+        const int  s = d > 0 ? 1 : -1;
+        const auto q = parabolic(i, s);
+        _q[i]        = _q[i - 1] < q && q < _q[i + 1] ? q : linear(i, s);
+        _pos[i] += s;
+      }
+    }
+  }
+
+  double value() const {
+    if (_n == 0) {
+      return 0;
+    }
+    if (_n < 5) {
+      return _q[static_cast<std::size_t>(std::round(_p * (_n - 1)))];
+    }
+    return _q[2];
+  }
+
+  uint64_t count() const {
+    return _n;
+  }
+
+  void save(std::ostream &out) const {
+    write_pod(out, _n);
+    write_pod(out, _q);
+    write_pod(out, _pos);
+    write_pod(out, _want);
+  }
+
+  void load(std::istream &in) {
+    read_pod(in, _n);
+    read_pod(in, _q);
+    read_pod(in, _pos);
+    read_pod(in, _want);
+  }
+
+private:
+  double parabolic(int i, int s) const {
+    return _q[i] + s / (_pos[i + 1] - _pos[i - 1]) *
+                       ((_pos[i] - _pos[i - 1] + s) * (_q[i + 1] - _q[i]) /
+                            (_pos[i + 1] - _pos[i]) +
+                        (_pos[i + 1] - _pos[i] - s) * (_q[i] - _q[i - 1]) /
+                            (_pos[i] - _pos[i - 1]));
+  }
+
+  double linear(int i, int s) const {
+    return _q[i] + s * (_q[i + s] - _q[i]) / (_pos[i + s] - _pos[i]);
+  }
+
+  double   _p;
+  uint64_t _n = 0;
+  // Marker heights, positions and desired positions
+  double   _q[5]   = {};
+  double   _pos[5] = {1, 2, 3, 4, 5};
+  double   _want[5];
+};
+
+/**
+ * Tail of the durations of a kernel's tasks in one problem size bucket, in
+ * seconds per FLOP so the sizes within the bucket share it.
+ */
+struct TailSketch {
+  void add(double seconds_per_flop) {
+    p95.add(seconds_per_flop);
+    p99.add(seconds_per_flop);
+  }
+
+  void save(std::ostream &out) const {
+    p95.save(out);
+    p99.save(out);
+  }
+
+  void load(std::istream &in) {
+    p95.load(in);
+    p99.load(in);
+  }
+
+  P2Quantile p95{0.95};
+  P2Quantile p99{0.99};
+};
+
+// Predicted duration quantiles in seconds
+struct Tail {
+  double p95 = 0;
+  double p99 = 0;
+};
+
+// Running mean of how much longer a kernel takes while another one runs
+struct Slowdown {
+  void add(double slowdown) {
+    n++;
+    mean += (slowdown - mean) / n;
+  }
+
+  uint64_t n    = 0;
+  double   mean = 1;
+};
+
 class Model {
 public:
   Model(const std::string &config)
@@ -29,10 +255,41 @@ public:
   static constexpr double offline_alpha = 0.0001;
 
   float cost(const Task &task) const {
-    auto       params = kernel_params(_config, task.function_name());
-    const auto total = task.global()[0] * task.global()[1];
-    float      cost   = offline_alpha + (params.flop(total) / params.max_flops());
-    return cost;
+    return kernel_cost(task) + transfer_cost(task.transfer_bytes());
+  }
+
+  float cost(const KernelParams &params, const Task &task) const {
+    return kernel_cost(params, task) + transfer_cost(task.transfer_bytes());
+  }
+
+  // Roofline: the kernel is bound by either its FLOPs or its memory traffic
+  float kernel_cost(const Task &task) const {
+    return kernel_cost(kernel_params(_config, task.function_name()), task);
+  }
+
+  float kernel_cost(const KernelParams &params, const Task &task) const {
+    const auto total   = task.problem_size();
+    double     compute = 0;
+    double     memory  = 0;
+    if (params.max_flops() > 0) {
+      compute = params.flop(total) / params.max_flops();
+    }
+    if (params.max_bandwidth() > 0) {
+      memory = params.bytes(total) / params.max_bandwidth();
+    }
+    return offline_alpha + params.latency() + std::max(compute, memory);
+  }
+
+  // Host<->device copies: a fixed latency plus the bytes over the link
+  float transfer_cost(std::size_t bytes) const {
+    if (bytes == 0) {
+      return 0;
+    }
+    const auto& link = transfer_params();
+    if (link.max_bandwidth() <= 0) {
+      return link.latency();
+    }
+    return link.latency() + bytes / link.max_bandwidth();
   }
 
   template<typename Tasks>
@@ -45,59 +302,168 @@ public:
   }
 
   void add_measurement(const Task &task, Measurement &m) {
-    _measurements.insert({task.function_name(), m});
+    _statistics[task.function_name()].add(m);
+  }
+
+  // Statistics of a kernel to update directly, the reference stays valid
+  Statistics &kernel_statistics(const std::string &kernel) {
+    return _statistics[kernel];
+  }
+
+  /**
+   * Least squares fit of duration over FLOPs for the task's kernel. Falls
+   * back to the offline roofline in seconds per FLOP until two distinct
+   * sizes have been measured, kernels without FLOPs to the task's cost.
+   */
+  Parameters linreg(const Task &task) const
+  {
+    return linreg(statistics(task), task);
+  }
+
+  Parameters linreg(const Statistics &stats, const Task &task) const
+  {
+    return linreg(stats, kernel_params(_config, task.function_name()), task);
   }
 
   Parameters linreg(
-      const Task &                  task,
-      std::function<double(double)> map = [](double v) { return v; }) const
+      const Statistics &stats, const KernelParams &params, const Task &task)
+      const
   {
-    auto   matches = _measurements.equal_range(task.function_name());
-    auto   begin   = matches.first;
-    auto   end     = matches.second;
-    double m       = std::distance(begin, end);
-
-    auto sum_x   = std::accumulate(begin, end, 0.0f, [&map](double sum, auto val) {
-      return sum + map(val.second.x);
-    });
-    auto sum_y   = std::accumulate(begin, end, 0.0f, [&map](double sum, auto val) {
-      return sum + map(val.second.y);
-    });
-    double avg_x = sum_x / m;
-    double avg_y = sum_y / m;
-
-    double  t = std::accumulate(begin, end, 0.0f, [avg_x, avg_y, &map](double sum, auto val) {
-      return sum + (map(val.second.x) - avg_x) * (map(val.second.y) - avg_y);
-    });
-    double b   = std::accumulate(begin, end, 0.0f, [avg_x, &map](double sum, auto val) {
-      return sum + (map(val.second.x) - avg_x) * (map(val.second.x) - avg_x);
-    });
-
-    auto   beta    = t / b;
-    auto   alpha   = avg_y - beta * avg_x;
+    if (stats.n < 2 || stats.m2_x <= 0) {
+      const auto flop = params.flop(task.problem_size());
+      if (flop <= 0) {
+        return Parameters{cost(params, task), 0};
+      }
+      return Parameters{0, cost(params, task) / flop};
+    }
+    auto beta  = stats.c_xy / stats.m2_x;
+    auto alpha = stats.mean_y - beta * stats.mean_x;
     return Parameters{alpha, beta};
   }
 
-  Parameters simple_linreg(const Task &task) {
-    auto   matches = _measurements.equal_range(task.function_name());
-    auto   begin   = matches.first;
-    auto   end     = matches.second;
-
-    auto sum_xy   = std::accumulate(begin, end, 0.0f, [](double sum, auto val) {
-      return sum + val.second.x * val.second.y;
-    });
-    auto sum_x2   = std::accumulate(begin, end, 0.0f, [](double sum, auto val) {
-      return sum + val.second.x * val.second.x;
-    });
+  // Fit through the origin, duration = beta * FLOPs
+  Parameters simple_linreg(const Task &task) const {
+    return simple_linreg(
+        statistics(task), kernel_params(_config, task.function_name()), task);
+  }
 
-    auto   beta    = sum_xy / sum_x2;
+  Parameters simple_linreg(
+      const Statistics &stats, const KernelParams &params, const Task &task)
+      const {
+    const auto sum_x2 = stats.sum_xx();
+    if (sum_x2 <= 0) {
+      const auto flop = params.flop(task.problem_size());
+      return Parameters{0, flop > 0 ? cost(params, task) / flop : 0};
+    }
+    auto beta = stats.sum_xy() / sum_x2;
     return Parameters{0, beta};
   }
 
+  // Slowdown of kernel while other ran next to it on the same bitstream
+  void add_slowdown(
+      const std::string &kernel, const std::string &other, double slowdown) {
+    _slowdowns[{kernel, other}].add(slowdown);
+  }
+
+  Slowdown slowdown(const std::string &kernel, const std::string &other) const
+  {
+    auto it = _slowdowns.find({kernel, other});
+    return it == _slowdowns.end() ? Slowdown{} : it->second;
+  }
+
+  // Only for runs alone, like the statistics
+  void add_tail(const Task &task, double flop, double seconds) {
+    _tails[task.function_name()][size_bucket(task.problem_size())].add(
+        seconds / std::max(flop, 1.0));
+  }
+
+  /**
+   * p95 and p99 of the task's duration from the sketch of its size bucket.
+   * The mean until a task of the bucket has been measured.
+   */
+  Tail tail(const Task &task, double flop, double mean) const {
+    const auto kernel = _tails.find(task.function_name());
+    if (kernel == _tails.end()) {
+      return {mean, mean};
+    }
+    const auto bucket = kernel->second.find(size_bucket(task.problem_size()));
+    if (bucket == kernel->second.end() || bucket->second.p95.count() == 0) {
+      return {mean, mean};
+    }
+    const auto scale = std::max(flop, 1.0);
+    return {bucket->second.p95.value() * scale,
+            bucket->second.p99.value() * scale};
+  }
+
+  Statistics statistics(const Task &task) const {
+    auto it = _statistics.find(task.function_name());
+    return it == _statistics.end() ? Statistics{} : it->second;
+  }
+
+  const std::string &config() const {
+    return _config;
+  }
+
+  // The bitstream is not part of the saved state, see model_store.h
+  void save(std::ostream &out) const {
+    write_pod(out, static_cast<uint32_t>(_statistics.size()));
+    for (const auto &kernel : _statistics) {
+      write_string(out, kernel.first);
+      kernel.second.save(out);
+    }
+    write_pod(out, static_cast<uint32_t>(_slowdowns.size()));
+    for (const auto &pair : _slowdowns) {
+      write_string(out, pair.first.first);
+      write_string(out, pair.first.second);
+      write_pod(out, pair.second.n);
+      write_pod(out, pair.second.mean);
+    }
+    uint32_t buckets = 0;
+    for (const auto &kernel : _tails) {
+      buckets += kernel.second.size();
+    }
+    write_pod(out, buckets);
+    for (const auto &kernel : _tails) {
+      for (const auto &bucket : kernel.second) {
+        write_string(out, kernel.first);
+        write_pod(out, static_cast<uint32_t>(bucket.first));
+        bucket.second.save(out);
+      }
+    }
+  }
+
+  void load(std::istream &in) {
+    uint32_t kernels = 0;
+    read_pod(in, kernels);
+    for (uint32_t i = 0; i < kernels && in; i++) {
+      auto name = read_string(in);
+      _statistics[name].load(in);
+    }
+    uint32_t pairs = 0;
+    read_pod(in, pairs);
+    for (uint32_t i = 0; i < pairs && in; i++) {
+      auto  kernel   = read_string(in);
+      auto  other    = read_string(in);
+      auto& slowdown = _slowdowns[{kernel, other}];
+      read_pod(in, slowdown.n);
+      read_pod(in, slowdown.mean);
+    }
+    uint32_t buckets = 0;
+    read_pod(in, buckets);
+    for (uint32_t i = 0; i < buckets && in; i++) {
+      auto     kernel = read_string(in);
+      uint32_t bucket = 0;
+      read_pod(in, bucket);
+      _tails[kernel][bucket].load(in);
+    }
+  }
 
 private:
   std::string _config;
-  std::multimap<std::string, Measurement> _measurements;
+  std::map<std::string, Statistics> _statistics;
+  std::map<std::pair<std::string, std::string>, Slowdown> _slowdowns;
+  // Kernel -> size bucket -> sketch
+  std::map<std::string, std::map<std::size_t, TailSketch>> _tails;
 };
 }
 
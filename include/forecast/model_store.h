@@ -0,0 +1,101 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <log.h>
+
+namespace forecast {
+
+/**
+ * Binary file holding the learned state of all models of a scheduler:
+ *
+ *   "FCST" | version | device identity | #models | model...
+ *
+ * Every model stores its bitstream followed by the statistics per kernel,
+ * the slowdowns per pair of kernels and the tail sketches per kernel and
+ * size bucket.
+ * Models are only loaded for the device identity they were learned on.
+ */
+constexpr char     model_store_magic[4] = {'F', 'C', 'S', 'T'};
+constexpr uint32_t model_store_version  = 3;
+
+std::string model_store_path()
+{
+  const char* env = std::getenv("FORECAST_MODELS");
+  return env ? env : "logs/models.bin";
+}
+
+bool save_models(
+    const std::string&                  path,
+    const std::string&                  identity,
+    const std::map<std::string, Model>& models)
+{
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    warn("Could not save models to {}", path);
+    return false;
+  }
+  out.write(model_store_magic, sizeof(model_store_magic));
+  write_pod(out, model_store_version);
+  write_string(out, identity);
+  write_pod(out, static_cast<uint32_t>(models.size()));
+  for (const auto& model : models) {
+    write_string(out, model.first);
+    model.second.save(out);
+  }
+  debug("Saved {} models to {}", models.size(), path);
+  return static_cast<bool>(out);
+}
+
+bool load_models(
+    const std::string&            path,
+    const std::string&            identity,
+    std::map<std::string, Model>& models)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+
+  char     magic[sizeof(model_store_magic)];
+  uint32_t version = 0;
+  in.read(magic, sizeof(magic));
+  read_pod(in, version);
+  if (!in || std::memcmp(magic, model_store_magic, sizeof(magic)) != 0 ||
+      version != model_store_version) {
+    warn("Ignoring models in {}: unknown format", path);
+    return false;
+  }
+
+  const auto stored_identity = read_string(in);
+  if (stored_identity != identity) {
+    warn(
+        "Ignoring models in {}: learned on {}, not {}",
+        path,
+        stored_identity,
+        identity);
+    return false;
+  }
+
+  uint32_t n_models = 0;
+  read_pod(in, n_models);
+  for (uint32_t i = 0; i < n_models && in; i++) {
+    const auto config = read_string(in);
+    models.try_emplace(config, config).first->second.load(in);
+  }
+  if (!in) {
+    warn("Models in {} are truncated", path);
+    return false;
+  }
+  debug("Loaded {} models from {}", n_models, path);
+  return true;
+}
+
+}  // namespace forecast
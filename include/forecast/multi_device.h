@@ -0,0 +1,153 @@
+#pragma once
+
+#include "backend.h"
+#include "model_store.h"
+#include "reorder.h"
+#include "scheduler.h"
+#include "task.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace forecast {
+
+/**
+ * Spreads tasks over several devices. Every device has a Scheduler of its
+ * own, with its own loaded configuration, queues and models, that groups
+ * its tasks by configuration (see Scheduler::enable_reordering). A task
+ * goes to the device and configuration with the earliest predicted
+ * completion: the work already placed on the device, a reconfiguration if
+ * the device ends up with another configuration loaded, and the task
+ * itself. Tasks may be added from several threads, their placement and
+ * the hand-off to the device's Scheduler are serialized.
+ */
+class MultiDeviceScheduler {
+public:
+  // Device i keeps its models in model_path.i and logs to
+  // logs/scheduler.i.csv, an empty model_path disables the models store
+  MultiDeviceScheduler(
+      std::vector<std::unique_ptr<Backend>> backends,
+      const std::string&                    model_path = model_store_path(),
+      double                                reconfiguration = 1.5,
+      ReorderPolicy                         policy = ReorderPolicy())
+    : _reconfiguration(reconfiguration)
+    , _devices(backends.size())
+  {
+    for (std::size_t i = 0; i < backends.size(); i++) {
+      auto& device     = _devices[i];
+      device.scheduler = std::make_unique<Scheduler>(
+          std::move(backends[i]),
+          model_path.empty() ? "" : model_path + "." + std::to_string(i),
+          "logs/scheduler." + std::to_string(i) + ".csv");
+      device.scheduler->enable_reordering(policy);
+      device.scheduler->set_completion_observer([&device](const Task& t) {
+        device.backlog_ns.fetch_sub(
+            t.backlog_ns(), std::memory_order_relaxed);
+      });
+    }
+  }
+
+  // The bitstream is available on every device
+  void add_config(const std::string& bitstream)
+  {
+    std::lock_guard<std::mutex> lg(_placement_m);
+    _configs.push_back(bitstream);
+    for (auto& device : _devices) {
+      device.scheduler->add_config(bitstream);
+      if (device.planned.empty()) {
+        device.planned = bitstream;
+      }
+    }
+  }
+
+  // Returns the device the task was placed on, also if its scheduler turned
+  // the task away, see Scheduler::add_task
+  std::size_t add_task(Task&& task)
+  {
+    std::size_t device = 0;
+    std::string config;
+    float       cost   = 0;
+    double      finish = std::numeric_limits<double>::max();
+    // Placements read and update the planned configurations, and a
+    // Scheduler takes tasks from one thread at a time
+    std::lock_guard<std::mutex> lg(_placement_m);
+    for (std::size_t d = 0; d < _devices.size(); d++) {
+      auto& dev = _devices[d];
+      // Admission may have refined the prediction of a placed task
+      const double backlog = std::max<int64_t>(
+          0, dev.backlog_ns.load(std::memory_order_relaxed));
+      for (const auto& c : _configs) {
+        if (task.config() ? *task.config() != c
+                          : !has_kernel_params(c, task.function_name())) {
+          continue;
+        }
+        const auto predicted = dev.scheduler->predict(task, c);
+        const auto f = backlog * 1e-9 + predicted +
+                       (c != dev.planned ? _reconfiguration : 0);
+        if (f < finish) {
+          finish = f;
+          device = d;
+          config = c;
+          cost   = predicted;
+        }
+      }
+    }
+    assert(!config.empty());
+
+    auto&      dev     = _devices[device];
+    const auto backlog = to_ns(cost);
+    dev.planned        = config;
+    dev.backlog_ns.fetch_add(backlog, std::memory_order_relaxed);
+    task.set_config(config);
+    task.set_predicted(cost);
+    task.set_backlog_ns(backlog);
+    if (!dev.scheduler->add_task(std::move(task))) {
+      dev.backlog_ns.fetch_sub(backlog, std::memory_order_relaxed);
+    }
+    return device;
+  }
+
+  void wait()
+  {
+    for (auto& device : _devices) {
+      device.scheduler->wait();
+    }
+  }
+
+  std::size_t device_count() const
+  {
+    return _devices.size();
+  }
+
+  Scheduler& device(std::size_t index)
+  {
+    return *_devices[index].scheduler;
+  }
+
+private:
+  struct Device {
+    std::unique_ptr<Scheduler> scheduler;
+    // Predicted nanoseconds of placed tasks that have not finished yet
+    std::atomic<int64_t> backlog_ns{0};
+    // Configuration loaded once the placed tasks have run
+    std::string planned;
+  };
+
+  static int64_t to_ns(float seconds)
+  {
+    return static_cast<int64_t>(seconds * 1e9);
+  }
+
+  double                   _reconfiguration;
+  std::vector<std::string> _configs;
+  std::vector<Device>      _devices;
+  std::mutex               _placement_m;
+};
+
+}  // namespace forecast
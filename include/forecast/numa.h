@@ -0,0 +1,290 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#include <log.h>
+
+namespace forecast {
+
+// From <linux/mempolicy.h>, so no libnuma is required
+constexpr int      mpol_bind    = 2;
+constexpr unsigned mpol_mf_move = 1 << 1;
+// cl_khr_pci_bus_info
+constexpr cl_uint pci_bus_info = 0x410F;
+
+constexpr char sysfs[] = "/sys/";
+
+// Number of NUMA nodes of the host, 1 without NUMA information
+int numa_node_count()
+{
+  int nodes = 0;
+  while (std::ifstream(
+      std::string(sysfs) + "devices/system/node/node" +
+      std::to_string(nodes) + "/cpulist")) {
+    nodes++;
+  }
+  return std::max(nodes, 1);
+}
+
+// "0-3,8,10-11" as in sysfs
+std::vector<int> parse_cpu_list(const std::string& list)
+{
+  std::vector<int>  cpus;
+  std::stringstream ss(list);
+  std::string       range;
+  while (std::getline(ss, range, ',')) {
+    int first = 0, last = 0;
+    const auto matched = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+    if (matched < 1) {
+      continue;
+    }
+    for (int cpu = first; cpu <= (matched == 2 ? last : first); cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<int> node_cpus(int node)
+{
+  std::ifstream in(
+      std::string(sysfs) + "devices/system/node/node" +
+      std::to_string(node) + "/cpulist");
+  std::string list;
+  std::getline(in, list);
+  return parse_cpu_list(list);
+}
+
+// Node of a PCI device like "0000:3b:00.0", -1 if unknown
+int pci_numa_node(const std::string& address)
+{
+  std::ifstream in(
+      std::string(sysfs) + "bus/pci/devices/" + address + "/numa_node");
+  int node = -1;
+  in >> node;
+  return in ? node : -1;
+}
+
+// PCI address of an OpenCL device, empty if the runtime does not tell
+std::string pci_address(const cl::Device& device)
+{
+  struct {
+    cl_uint domain, bus, device, function;
+  } pci;
+  const auto err =
+      clGetDeviceInfo(device(), pci_bus_info, sizeof(pci), &pci, nullptr);
+  if (err != CL_SUCCESS) {
+    return "";
+  }
+  char address[16];
+  std::snprintf(
+      address,
+      sizeof(address),
+      "%04x:%02x:%02x.%x",
+      pci.domain,
+      pci.bus,
+      pci.device,
+      pci.function);
+  return address;
+}
+
+// FORECAST_NUMA_NODE overrides the node, e.g. for boards whose runtime
+// does not report the PCI address. -1 if unknown.
+int device_numa_node(const cl::Device& device)
+{
+  if (const char* env = std::getenv("FORECAST_NUMA_NODE")) {
+    return std::atoi(env);
+  }
+  const auto address = pci_address(device);
+  return address.empty() ? -1 : pci_numa_node(address);
+}
+
+// Restricts the calling thread to the CPUs of the node
+bool pin_thread(int node)
+{
+  const auto cpus = node_cpus(node);
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Places the pages of the range on the node, pages already touched move
+bool bind_memory(void* addr, std::size_t bytes, int node)
+{
+  if (node < 0 || node >= static_cast<int>(8 * sizeof(unsigned long))) {
+    errno = EINVAL;
+    return false;
+  }
+  const unsigned long mask = 1ul << node;
+  return syscall(
+             SYS_mbind,
+             addr,
+             bytes,
+             mpol_bind,
+             &mask,
+             8 * sizeof(mask),
+             mpol_mf_move) == 0;
+}
+
+/**
+ * The NUMA node of a board, for its host threads and staging memory.
+ * FORECAST_NUMA_NODE overrides it. -1 on hosts with a single node or if
+ * the node is unknown, nothing is placed then.
+ */
+int board_numa_node(const cl::Device& device)
+{
+  if (numa_node_count() < 2 && !std::getenv("FORECAST_NUMA_NODE")) {
+    return -1;
+  }
+  const auto node = device_numa_node(device);
+  if (node >= 0) {
+    info("Placing the host threads of a board on NUMA node {}", node);
+  }
+  return node;
+}
+
+// For the threads of a backend on start, see Backend::numa_node
+void pin_current_thread(int node)
+{
+  if (node >= 0 && !pin_thread(node)) {
+    warn("Could not pin a thread to NUMA node {}", node);
+  }
+}
+
+// Pins the calling thread to a node while it lives, then restores the
+// affinity the thread had before
+class ScopedPin {
+public:
+  explicit ScopedPin(int node)
+  {
+    _saved = pthread_getaffinity_np(
+                 pthread_self(), sizeof(_previous), &_previous) == 0;
+    pin_current_thread(node);
+  }
+
+  ~ScopedPin()
+  {
+    if (_saved) {
+      pthread_setaffinity_np(pthread_self(), sizeof(_previous), &_previous);
+    }
+  }
+
+  ScopedPin(const ScopedPin&) = delete;
+  ScopedPin& operator=(const ScopedPin&) = delete;
+
+private:
+  cpu_set_t _previous;
+  bool      _saved = false;
+};
+
+/**
+ * Allocates whole pages bound to a NUMA node, e.g. the Backend::numa_node
+ * of the board the memory is copied to. They are mapped and bound before
+ * they are first touched. Without a node the memory comes from operator
+ * new and is placed by first touch.
+ */
+template <typename T>
+struct NumaAllocator {
+  using value_type = T;
+
+  NumaAllocator() = default;
+
+  explicit NumaAllocator(int node)
+    : node(node)
+  {
+  }
+
+  template <typename U>
+  NumaAllocator(const NumaAllocator<U>& other)
+    : node(other.node)
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+    if (node < 0) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    const auto bytes = mapped_bytes(n);
+    void*      p     = mmap(
+        nullptr,
+        bytes,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (p == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    if (!bind_memory(p, bytes, node)) {
+      warn(
+          "Could not bind {} bytes to NUMA node {}: {}",
+          bytes,
+          node,
+          std::strerror(errno));
+    }
+    return static_cast<T*>(p);
+  }
+
+  void deallocate(T* p, std::size_t n)
+  {
+    if (node < 0) {
+      ::operator delete(p);
+      return;
+    }
+    munmap(p, mapped_bytes(n));
+  }
+
+  template <typename U>
+  bool operator==(const NumaAllocator<U>& other) const
+  {
+    return node == other.node;
+  }
+
+  template <typename U>
+  bool operator!=(const NumaAllocator<U>& other) const
+  {
+    return node != other.node;
+  }
+
+  int node = -1;
+
+private:
+  static std::size_t mapped_bytes(std::size_t n)
+  {
+    const auto page  = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const auto bytes = (n * sizeof(T) + page - 1) / page * page;
+    return std::max(bytes, page);
+  }
+};
+
+// Host buffer for transfers to and from the board
+template <typename T>
+using HostVector = std::vector<T, NumaAllocator<T>>;
+
+}  // namespace forecast
@@ -1,20 +1,46 @@
 #pragma once
 
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <log.h>
 
 #define GFLOPS * static_cast<std::size_t>(1000000000)
 
 namespace forecast {
 
+using FlopFun = std::function<float(std::size_t)>;
+using ByteFun = std::function<double(std::size_t)>;
+
+ByteFun byte_function(const std::string& kernel);
+
 struct KernelParams {
   KernelParams() = default;
-  KernelParams(std::size_t max_flops, std::function<float(std::size_t)> flops)
+  KernelParams(
+      std::size_t max_flops,
+      FlopFun     flops,
+      double      max_bandwidth = 0,
+      ByteFun     bytes         = byte_function(""),
+      double      latency       = 0)
     : _max_flops(max_flops)
+    , _max_bandwidth(max_bandwidth)
+    , _latency(latency)
     , _flops_fun(flops)
+    , _bytes_fun(bytes)
   {
   }
   float flop(std::size_t n) const
@@ -22,15 +48,34 @@ struct KernelParams {
     return _flops_fun(n);
   }
 
+  // Bytes moved between the kernel and global memory
+  double bytes(std::size_t n) const
+  {
+    return _bytes_fun(n);
+  }
+
+  // Fixed cost in seconds, e.g. of a transfer or launch
+  double latency() const {
+    return _latency;
+  }
+
   float max_flops() const {
     return _max_flops;
   }
 
+  // Bytes per second, 0 if unknown
+  double max_bandwidth() const {
+    return _max_bandwidth;
+  }
+
 
   private:
   // FLOPS
   float _max_flops = 1;
-  std::function<float(std::size_t)> _flops_fun;
+  double _max_bandwidth = 0;
+  double _latency = 0;
+  FlopFun _flops_fun;
+  ByteFun _bytes_fun;
 };
 
 auto matrix_mult = [](std::size_t n) {
@@ -39,23 +84,318 @@ auto matrix_mult = [](std::size_t n) {
   return static_cast<float>(total_flops);
 };
 
-KernelParams& kernel_params(const std::string& config, const std::string& kernel) {
-  static std::map<std::string, std::map<std::string, KernelParams>> params;
+// a[i] = b[i] * c[i] + d[i]
+auto vector_triad = [](std::size_t n) {
+  return static_cast<float>(2 * n);
+};
+
+// 5 N log2 N per transform of 2^14 points (fft1d.cl), n points in total
+auto fft_1d = [](std::size_t n) {
+  return static_cast<float>(5 * 14 * n);
+};
+
+// The FLOP formula of a kernel only depends on its name, not the bitstream
+FlopFun flop_function(const std::string& kernel)
+{
+  if (kernel.rfind("matrixMult", 0) == 0) {
+    return matrix_mult;
+  }
+  if (kernel.rfind("vector_triad", 0) == 0) {
+    return vector_triad;
+  }
+  if (kernel == "fft1d") {
+    return fft_1d;
+  }
+  return [](std::size_t) { return 0.0f; };
+}
+
+// Blocked matrix multiplication reads a row of blocks of A and a column of
+// blocks of B for every block of C and writes C once.
+auto matrix_mult_bytes(std::size_t value_size, std::size_t block_size = 64)
+{
+  return [value_size, block_size](std::size_t n) {
+    const double len = std::sqrt(n);
+    return value_size * (2 * len * len * len / block_size + len * len);
+  };
+}
+
+// Three float arrays are read and one is written
+auto vector_triad_bytes = [](std::size_t n) {
+  return static_cast<double>(4 * sizeof(float) * n);
+};
+
+ByteFun byte_function(const std::string& kernel)
+{
+  if (kernel == "matrixMultD") {
+    return matrix_mult_bytes(sizeof(double));
+  }
+  if (kernel.rfind("matrixMult", 0) == 0) {
+    return matrix_mult_bytes(sizeof(float));
+  }
+  if (kernel.rfind("vector_triad", 0) == 0) {
+    return vector_triad_bytes;
+  }
+  return [](std::size_t) { return 0.0; };
+}
+
+using ParamTable = std::map<std::string, std::map<std::string, KernelParams>>;
+
+// Name of the pseudo-configuration holding host<->device transfers
+constexpr char host_config[]     = "host";
+constexpr char transfer_kernel[] = "transfer";
+
+// Parses the whole field, blanks around the number allowed
+bool parse_double(const std::string& field, double& value)
+{
+  const char* begin = field.c_str();
+  char*       end   = nullptr;
+  errno             = 0;
+  value             = std::strtod(begin, &end);
+  if (end == begin || errno == ERANGE || !std::isfinite(value)) {
+    return false;
+  }
+  while (std::isspace(static_cast<unsigned char>(*end))) {
+    end++;
+  }
+  return *end == '\0';
+}
+
+/**
+ * Read calibrated parameters as written by Calibration::write. Every line
+ * holds "config, kernel, max_flops, max_bandwidth[, latency]", malformed
+ * lines are skipped. Returns the number of entries read.
+ */
+std::size_t load_kernel_params(ParamTable& params, const std::string& path)
+{
+  std::ifstream in(path);
+  std::string   line;
+  std::size_t   count  = 0;
+  std::size_t   number = 0;
+  while (std::getline(in, line)) {
+    number++;
+    std::stringstream ss(line);
+    std::string       config, kernel, max_flops, max_bandwidth, latency;
+    std::getline(ss >> std::ws, config, ',');
+    std::getline(ss >> std::ws, kernel, ',');
+    std::getline(ss >> std::ws, max_flops, ',');
+    std::getline(ss >> std::ws, max_bandwidth, ',');
+    std::getline(ss >> std::ws, latency, ',');
+    if (config.empty() || config == "config") {
+      continue;
+    }
+    double flops = 0, bandwidth = 0, seconds = 0;
+    if (kernel.empty() || !parse_double(max_flops, flops) ||
+        !parse_double(max_bandwidth, bandwidth) ||
+        (!latency.empty() && !parse_double(latency, seconds)) ||
+        flops < 0 || bandwidth < 0 || seconds < 0) {
+      warn("Skipping malformed line {} of {}: {}", number, path, line);
+      continue;
+    }
+    // Transfers are predicted from the bandwidth alone
+    if (config == host_config && kernel == transfer_kernel &&
+        bandwidth <= 0) {
+      warn("Skipping host transfers without a bandwidth in {}", path);
+      continue;
+    }
+    params[config][kernel] = KernelParams{
+        static_cast<std::size_t>(flops),
+        flop_function(kernel),
+        bandwidth,
+        byte_function(kernel),
+        seconds};
+    count++;
+  }
+  return count;
+}
+
+std::string kernel_params_path()
+{
+  const char* env = std::getenv("FORECAST_PARAMS");
+  return env ? env : "../kernels/kernel_params.csv";
+}
 
-  if(params.empty()) {
-    params["mmult_f_d"]["matrixMult"] =
-        KernelParams{120 GFLOPS, matrix_mult};
-    params["mmult_f_d"]["matrixMultD"] =
-        KernelParams{63 GFLOPS, matrix_mult};
-    params["mmult_f_d2"]["matrixMult"] =
-        KernelParams{35 GFLOPS, matrix_mult};
-    params["mmult_f_d2"]["matrixMultD"] =
-        KernelParams{72 GFLOPS, matrix_mult};
+/**
+ * Stable home of the parameters of one kernel in one bitstream. Holders,
+ * e.g. the scheduler's bindings, get() the value on every use and see
+ * what set_kernel_params stores later, it swaps the value in place.
+ */
+class ParamSlot {
+public:
+  const KernelParams& get() const
+  {
+    return *_value.load(std::memory_order_acquire);
   }
 
-  assert(params.size() == 2);
+  void set(const KernelParams* value)
+  {
+    _value.store(value, std::memory_order_release);
+  }
+
+private:
+  std::atomic<const KernelParams*> _value{nullptr};
+};
+
+/**
+ * Parameters of all bitstreams. Lookups take no lock: the index from
+ * names to slots is copy-on-write and only copied when a kernel is new to
+ * a bitstream, values are replaced in their slot. Superseded indices and
+ * values stay alive since readers may still hold them, there are only as
+ * many as parameters were set or kernels added.
+ */
+class ParamTables {
+public:
+  ParamTables()
+  {
+    ParamTable params;
+    // Defaults for bitstreams that have not been calibrated yet
+    params["mmult_f_d"]["matrixMult"] = KernelParams{
+        120 GFLOPS, matrix_mult, 0, byte_function("matrixMult")};
+    params["mmult_f_d"]["matrixMultD"] = KernelParams{
+        63 GFLOPS, matrix_mult, 0, byte_function("matrixMultD")};
+    params["mmult_f_d2"]["matrixMult"] = KernelParams{
+        35 GFLOPS, matrix_mult, 0, byte_function("matrixMult")};
+    params["mmult_f_d2"]["matrixMultD"] = KernelParams{
+        72 GFLOPS, matrix_mult, 0, byte_function("matrixMultD")};
+    // Nominal PCIe Gen3 x8 until the link has been measured
+    params[host_config][transfer_kernel] =
+        KernelParams{0, flop_function(""), 6.0e9, byte_function(""), 2e-5};
+
+    const auto path   = kernel_params_path();
+    const auto loaded = load_kernel_params(params, path);
+    debug("Loaded {} kernel parameters from {}", loaded, path);
+
+    Index index;
+    for (auto& config : params) {
+      for (auto& kernel : config.second) {
+        index[config.first][kernel.first] =
+            new_slot(std::move(kernel.second));
+      }
+    }
+    publish(std::move(index));
+  }
+
+  // Null if the bitstream is not known to contain the kernel
+  const ParamSlot* find(
+      const std::string& config, const std::string& kernel) const
+  {
+    return lookup(config, kernel);
+  }
+
+  // The slot of the kernel, created with default if it has none
+  template <typename Default>
+  const ParamSlot& slot(
+      const std::string& config, const std::string& kernel, Default&& make)
+  {
+    if (const auto* slot = find(config, kernel)) {
+      return *slot;
+    }
+    std::lock_guard<std::mutex> lg(_m);
+    if (const auto* slot = find(config, kernel)) {
+      return *slot;
+    }
+    auto  index           = *_index.load(std::memory_order_relaxed);
+    auto* slot            = new_slot(make());
+    index[config][kernel] = slot;
+    publish(std::move(index));
+    return *slot;
+  }
+
+  void set(
+      const std::string& config,
+      const std::string& kernel,
+      KernelParams       params)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    if (auto* slot = lookup(config, kernel)) {
+      _values.push_back(std::move(params));
+      slot->set(std::addressof(_values.back()));
+      return;
+    }
+    auto index            = *_index.load(std::memory_order_relaxed);
+    index[config][kernel] = new_slot(std::move(params));
+    publish(std::move(index));
+  }
+
+private:
+  using Index = std::map<std::string, std::map<std::string, ParamSlot*>>;
+
+  ParamSlot* lookup(const std::string& config, const std::string& kernel)
+      const
+  {
+    const auto& index = *_index.load(std::memory_order_acquire);
+    auto        it    = index.find(config);
+    if (it == index.end()) {
+      return nullptr;
+    }
+    auto kt = it->second.find(kernel);
+    return kt == it->second.end() ? nullptr : kt->second;
+  }
+
+  // Requires _m, except in the constructor
+  ParamSlot* new_slot(KernelParams&& params)
+  {
+    _values.push_back(std::move(params));
+    _slots.emplace_back();
+    _slots.back().set(std::addressof(_values.back()));
+    return std::addressof(_slots.back());
+  }
+
+  // Requires _m, except in the constructor
+  void publish(Index&& index)
+  {
+    _indices.push_back(std::make_unique<const Index>(std::move(index)));
+    _index.store(_indices.back().get(), std::memory_order_release);
+  }
+
+  std::mutex                                _m;
+  // Deques, their elements do not move
+  std::deque<KernelParams>                  _values;
+  std::deque<ParamSlot>                     _slots;
+  std::vector<std::unique_ptr<const Index>> _indices;
+  std::atomic<const Index*>                 _index{nullptr};
+};
+
+// Loaded on first use
+ParamTables& param_tables()
+{
+  static ParamTables tables;
+  return tables;
+}
+
+// Whether the bitstream is known to contain the kernel
+bool has_kernel_params(const std::string& config, const std::string& kernel) {
+  return param_tables().find(config, kernel) != nullptr;
+}
+
+// Hold the slot rather than the parameters to see later set_kernel_params
+const ParamSlot& kernel_param_slot(
+    const std::string& config, const std::string& kernel)
+{
+  return param_tables().slot(config, kernel, [&]() {
+    warn("No parameters for {} in {}, run a calibration", kernel, config);
+    // Unknown peaks, only the latency is predicted
+    return KernelParams{0, flop_function(kernel), 0, byte_function(kernel)};
+  });
+}
+
+const KernelParams& kernel_params(
+    const std::string& config, const std::string& kernel)
+{
+  return kernel_param_slot(config, kernel).get();
+}
+
+// Overrides calibrated and default parameters, e.g. for simulated
+// bitstreams. Holders of the kernel's slot see the new parameters.
+void set_kernel_params(
+    const std::string& config, const std::string& kernel, KernelParams params)
+{
+  param_tables().set(config, kernel, std::move(params));
+}
 
-  return params.at(config).at(kernel);
+// Latency and bandwidth of host<->device transfers
+const KernelParams& transfer_params()
+{
+  return kernel_params(host_config, transfer_kernel);
 }
 
 }
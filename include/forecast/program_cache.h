@@ -0,0 +1,224 @@
+#pragma once
+
+#include <CL/cl.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include <log.h>
+#include <util.h>
+
+#include "task.h"
+
+namespace forecast {
+
+std::string kernels_path()
+{
+  const char* env = std::getenv("FORECAST_KERNELS");
+  return env ? env : "../kernels/";
+}
+
+// Binaries of programs built from source, keyed by a hash of their input
+std::string program_cache_path()
+{
+  const char* env = std::getenv("FORECAST_PROGRAM_CACHE");
+  return env ? env : "logs/programs/";
+}
+
+// OpenCL source of a bitstream and the options the kernels Makefile builds
+// it with
+struct ProgramSource {
+  std::string file;
+  std::string options;
+};
+
+ProgramSource program_source(const std::string& bitstream)
+{
+  // vector_triad_n<K> is vector_triad.cl with K kernels
+  const std::string triad_variant = "vector_triad_n";
+  if (bitstream.rfind(triad_variant, 0) == 0) {
+    return {kernels_path() + "vector_triad.cl",
+            "-DNUM_KERNELS=" + bitstream.substr(triad_variant.size())};
+  }
+  return {kernels_path() + bitstream + ".cl", ""};
+}
+
+// 64-bit FNV-1a, stable across runs and platforms
+uint64_t fnv1a(
+    const std::string& data, uint64_t hash = 14695981039346656037ull)
+{
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool file_exists(const std::string& path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+std::string read_text_file(const std::string& path)
+{
+  std::ifstream     in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+// Cache file of the device's binary for the source and options
+std::string program_cache_file(
+    const std::string& bitstream,
+    const std::string& source,
+    const std::string& options,
+    const cl::Device&  device)
+{
+  auto hash = fnv1a(source);
+  hash      = fnv1a(options, hash);
+  hash      = fnv1a(device.getInfo<CL_DEVICE_NAME>(), hash);
+  hash      = fnv1a(device.getInfo<CL_DRIVER_VERSION>(), hash);
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+  return program_cache_path() + bitstream + "-" + hex + ".bin";
+}
+
+// Creates the directory and its missing parents, like mkdir -p
+bool make_directories(const std::string& path)
+{
+  for (auto pos = path.find('/', 1); pos != std::string::npos;
+       pos      = path.find('/', pos + 1)) {
+    mkdir(path.substr(0, pos).c_str(), 0755);
+  }
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+// Written to a uniquely named temporary file first, concurrent processes
+// never see half a binary
+void write_program_cache(
+    const std::string& path, const std::vector<char>& binary)
+{
+  const auto dir = program_cache_path();
+  if (!make_directories(dir)) {
+    warn("Could not create {}: {}", dir, std::strerror(errno));
+    return;
+  }
+  std::string tmp = path + ".XXXXXX";
+  const int   fd  = mkstemp(&tmp[0]);
+  if (fd < 0) {
+    warn("Could not create {}: {}", tmp, std::strerror(errno));
+    return;
+  }
+  // mkstemp creates it for the owner only
+  fchmod(fd, 0644);
+  FILE*      out     = fdopen(fd, "wb");
+  const bool written = out &&
+                       std::fwrite(binary.data(), 1, binary.size(), out) ==
+                           binary.size();
+  const bool closed = out ? std::fclose(out) == 0 : close(fd) == 0;
+  if (!written || !closed) {
+    warn("Could not write program cache {}", tmp);
+    std::remove(tmp.c_str());
+    return;
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    warn("Could not rename {} to {}: {}", tmp, path, std::strerror(errno));
+    std::remove(tmp.c_str());
+  }
+}
+
+/**
+ * The program of a bitstream for the devices. Prefers the prebuilt .aocx
+ * from kernels_path(). Runtimes that compile from source, e.g. on CPUs, get
+ * the matching .cl file instead, built once and then loaded from the
+ * on-disk cache. A cache entry is keyed by the source, the build options
+ * and the device and driver, so an edited kernel is rebuilt.
+ */
+cl::Program build_program(
+    cl::Context&                   ctx,
+    const std::vector<cl::Device>& devices,
+    const std::string&             bitstream)
+{
+  const auto aocx = kernels_path() + bitstream + ".aocx";
+  if (file_exists(aocx)) {
+    Binary      binary(aocx.c_str());
+    cl::Program program(ctx, devices, binary.cl_binaries());
+    cl_ok(program.build());
+    return program;
+  }
+
+  const auto begin  = Clock::now();
+  const auto src    = program_source(bitstream);
+  const auto source = read_text_file(src.file);
+  if (source.empty()) {
+    critical("Neither {} nor {} found", aocx, src.file);
+  }
+
+  std::vector<std::string> files;
+  std::vector<Binary>      cached;
+  cl::Program::Binaries    binaries;
+  for (const auto& device : devices) {
+    files.push_back(
+        program_cache_file(bitstream, source, src.options, device));
+    if (file_exists(files.back())) {
+      cached.emplace_back(files.back().c_str());
+    }
+  }
+  if (cached.size() == devices.size()) {
+    for (auto& binary : cached) {
+      binaries.emplace_back(binary.bytes.data(), binary.bytes.size());
+    }
+    cl_int      err = CL_SUCCESS;
+    cl::Program program(ctx, devices, binaries, nullptr, &err);
+    if (err == CL_SUCCESS &&
+        program.build(devices, src.options.c_str()) == CL_SUCCESS) {
+      const std::chrono::duration<double, std::milli> took =
+          Clock::now() - begin;
+      debug(
+          "Loaded {} from the program cache in {}ms",
+          bitstream,
+          took.count());
+      return program;
+    }
+    warn("Ignoring the cached binary of {}, it does not load", bitstream);
+  }
+
+  cl::Program program(ctx, source);
+  if (program.build(devices, src.options.c_str()) != CL_SUCCESS) {
+    for (const auto& device : devices) {
+      critical(
+          "Building {} failed:\n{}",
+          src.file,
+          program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device));
+    }
+    cl_ok(CL_BUILD_PROGRAM_FAILURE);
+  }
+
+  // One binary per device, in the order of the program's devices
+  const auto sizes = program.getInfo<CL_PROGRAM_BINARY_SIZES>();
+  std::vector<std::vector<char>> built(sizes.size());
+  std::vector<char*>             pointers;
+  for (std::size_t i = 0; i < sizes.size(); i++) {
+    built[i].resize(sizes[i]);
+    pointers.push_back(built[i].data());
+  }
+  cl_ok(program.getInfo(CL_PROGRAM_BINARIES, &pointers));
+  for (std::size_t i = 0; i < built.size() && i < files.size(); i++) {
+    write_program_cache(files[i], built[i]);
+  }
+  const std::chrono::duration<double, std::milli> took = Clock::now() - begin;
+  info("Built {} from {} in {}ms", bitstream, src.file, took.count());
+  return program;
+}
+
+}  // namespace forecast
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "backend.h"
+#include "metrics.h"
+#include "numa.h"
 #include "task.h"
+#include "task_pool.h"
+#include "tracer.h"
 
-#include <CL/cl.hpp>
 #include <condition_variable>
 #include <map>
 #include <set>
@@ -11,38 +15,90 @@
 
 namespace forecast {
 
-using TaskCallback = std::function<void(Task)>;
+using TaskCallback = std::function<void(Task&)>;
+
+// Decides when a queue may launch its next task, e.g. to keep kernels that
+// contend for the device apart. Called on the queue threads.
+class LaunchGate {
+public:
+  virtual ~LaunchGate() = default;
+
+  // Blocks until the task may launch
+  virtual void acquire(const Task& task) = 0;
+  virtual void release(const Task& task) = 0;
+};
+
+// Folds the next waiting task into the one about to launch if it returns
+// true, called with the queue locked
+using Coalescer = std::function<bool(Task&, const Task&)>;
+
+// Fifo runs tasks in submission order, Deadline as ordered by TaskHeap
+enum class QueueOrder { Fifo, Deadline };
 
 class Queue {
 public:
-  Queue(const cl::Context& ctx, cl::Program* program, TaskCallback &&clb)
-    : _program(program)
-    , _command_queue(cl::CommandQueue(ctx))
+  Queue(
+      Backend&           backend,
+      TaskCallback&&     clb,
+      const std::string& name    = "",
+      KernelMetrics*     metrics = nullptr,
+      QueueOrder         order   = QueueOrder::Fifo)
+    : _name(name)
+    , _metrics(metrics)
+    , _order(order)
+    , _stream(backend.create_stream())
+    , _numa_node(backend.numa_node())
     , _clb(std::move(clb))
     , _thread(std::bind(&Queue::queue_loop, this))
   {
   }
-  Queue(cl::CommandQueue&& command_queue) = delete;
   Queue() = delete;
 
   void enqueue(Task &&task) {
     assert(!_finished);
     debug("-> Task {} ({})", task.function_name(), task.id());
+    if (_metrics) {
+      _metrics->submitted.fetch_add(1, std::memory_order_relaxed);
+      _metrics->depth.fetch_add(1, std::memory_order_relaxed);
+    }
     {
       std::lock_guard<std::mutex> lg(_m);
-      _tasks.push_back(task);
+      push(_pool.acquire(std::move(task)));
     }
     _cv.notify_all();
   }
 
-  void set_program(cl::Program* program) {
+  // Pending tasks are reordered right away
+  void set_order(QueueOrder order) {
+    std::lock_guard<std::mutex> lg(_m);
+    if (order == _order) {
+      return;
+    }
+    _order = order;
+    while (!_tasks.empty()) {
+      push(_tasks.pop());
+    }
+    while (!_ordered.empty()) {
+      push(_ordered.pop());
+    }
+  }
+
+  // Applies from the next launch on, nullptr launches right away
+  void set_gate(LaunchGate* gate) {
     std::lock_guard<std::mutex> lg(_m);
-    _program = program;
+    _gate = gate;
+  }
+
+  // Applies from the next launch on, an empty coalescer launches every task
+  // on its own
+  void set_coalescer(Coalescer coalescer) {
+    std::lock_guard<std::mutex> lg(_m);
+    _coalescer = std::move(coalescer);
   }
 
   void wait() {
     std::unique_lock<std::mutex> lk(_m);
-    _cv.wait(lk, [this]() { return not _working && _tasks.size() == 0; });
+    _cv.wait(lk, [this]() { return not _working && pending() == 0; });
   }
 
   void finish() {
@@ -54,42 +110,53 @@ public:
   }
 
   void queue_loop() {
+    tracer().set_thread_name("queue " + _name);
+    pin_current_thread(_numa_node);
     while(not _finished) {
       std::unique_lock<std::mutex> lk(_m);
       _cv.wait(lk, [this]() {
-        return not _working && (_tasks.size() > 0 || _finished);
+        return not _working && (pending() > 0 || _finished);
       });
-      if (_finished && _tasks.size() == 0) {
+      if (_finished && pending() == 0) {
         return;
       }
-      auto& task  = _tasks.front();
-      auto& event = pass_to_cl(task);
-      _working = true;
+      Task* task = pop();
+      while (_coalescer && pending() > 0 && _coalescer(*task, *front())) {
+        _pool.release(pop());
+      }
+      auto* gate = _gate;
+      _working   = true;
       lk.unlock();
 
-      event.wait();
-
+      if (gate) {
+        gate->acquire(*task);
+      }
+      _stream->launch(*task);
+      _stream->wait(*task);
+      task->finished_now();
+      if (gate) {
+        gate->release(*task);
+      }
+      _clb(*task);
+      const auto callback_done = Clock::now();
+      tracer().task(*task, callback_done);
+      if (_metrics) {
+        record(*task, callback_done);
+      }
+      debug("<- Task {}", task->id());
 
       {
-        std::unique_lock<std::mutex> lg(_m);
-        auto finished_task = std::move(_tasks.front());
-        finished_task.finished_now();
-        _tasks.pop_front();
+        std::lock_guard<std::mutex> lg(_m);
+        _pool.release(task);
         _working = false;
-        lg.unlock();
-        _clb(finished_task);
-        debug("<- Task {}", task.id());
       }
       _cv.notify_all();
     }
   }
 
+  // Pending tasks and the running one
   std::size_t size() const {
-    return _tasks.size();
-  }
-
-  const Tasks &tasks() const {
-    return _tasks;
+    return pending() + (_working ? 1 : 0);
   }
 
   ~Queue() {
@@ -97,28 +164,56 @@ public:
     _thread.join();
   }
 private:
-  cl::Event& pass_to_cl(Task& task) {
-    auto& kernel = task.generate_kernel(*_program);
-    auto& kernel_done = task.kernel_done();
-    task.enqueued_now();
-    cl_ok(_command_queue.enqueueNDRangeKernel(
-        kernel,
-        task.offset(),
-        task.global(),
-        task.local(),
-        NULL,
-        std::addressof(kernel_done)));
-    return kernel_done;
+  // Require _m
+  void push(Task* task) {
+    if (_order == QueueOrder::Fifo) {
+      _tasks.push(task);
+    } else {
+      _ordered.push(task);
+    }
   }
 
-private:
-  cl::Program*            _program;
+  Task* pop() {
+    return _order == QueueOrder::Fifo ? _tasks.pop() : _ordered.pop();
+  }
+
+  Task* front() const {
+    return _order == QueueOrder::Fifo ? _tasks.front() : _ordered.front();
+  }
+
+  std::size_t pending() const {
+    return _tasks.size() + _ordered.size();
+  }
+
+  void record(const Task& task, TimePoint callback_done)
+  {
+    _metrics->depth.fetch_sub(task.merged(), std::memory_order_relaxed);
+    _metrics->completed.fetch_add(task.merged(), std::memory_order_relaxed);
+    if (task.has_deadline()) {
+      _metrics->deadlines.fetch_add(1, std::memory_order_relaxed);
+      if (task.finished_at() > task.deadline()) {
+        _metrics->deadline_misses.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    _metrics->queue_wait.record(task.enqueued_at() - task.created_at());
+    _metrics->device.record(task.finished_at() - task.started_at());
+    _metrics->callback.record(callback_done - task.finished_at());
+  }
+
+  std::string             _name;
+  KernelMetrics*          _metrics;
+  QueueOrder              _order;
+  std::unique_ptr<Stream> _stream;
+  int                     _numa_node;
   std::condition_variable _cv;
   std::mutex              _m;
-  cl::CommandQueue        _command_queue;
   bool                    _finished = false;
   bool                    _working = false;
-  Tasks                   _tasks;
+  TaskPool                _pool;
+  TaskRing                _tasks;
+  TaskHeap                _ordered;
+  LaunchGate*             _gate = nullptr;
+  Coalescer               _coalescer;
   TaskCallback            _clb;
   std::thread             _thread;
 };
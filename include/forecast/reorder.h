@@ -0,0 +1,134 @@
+#pragma once
+
+#include "queue.h"
+#include "task.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <vector>
+
+namespace forecast {
+
+struct ReorderPolicy {
+  // Pending tasks to look ahead, a full window switches to the oldest one
+  std::size_t window = 64;
+  // Seconds a task may be held back for work of the loaded configuration
+  double max_delay = 1.0;
+};
+
+struct PendingTask {
+  Task        task;
+  Queue*      queue;
+  std::size_t config;
+  // Predicted seconds on its configuration
+  float       cost;
+};
+
+/**
+ * Tasks that wait for their configuration to be loaded. Each configuration
+ * keeps its tasks in arrival order, the window decides which configuration
+ * to load next: the one of the oldest task once that has waited too long or
+ * the window is full, otherwise the one with the most predicted work.
+ */
+class ReorderWindow {
+public:
+  void push(PendingTask&& pending)
+  {
+    if (_configs.size() <= pending.config) {
+      _configs.resize(pending.config + 1);
+    }
+    auto& config = _configs[pending.config];
+    config.work += pending.cost;
+    config.tasks.push_back(std::move(pending));
+    _size++;
+  }
+
+  // Hand all pending tasks of the configuration to release, oldest first
+  template <typename Release>
+  void release(std::size_t index, Release&& release)
+  {
+    if (index >= _configs.size()) {
+      return;
+    }
+    auto& config = _configs[index];
+    while (!config.tasks.empty()) {
+      auto pending = std::move(config.tasks.front());
+      config.tasks.pop_front();
+      _size--;
+      release(std::move(pending));
+    }
+    config.work = 0;
+  }
+
+  bool empty() const
+  {
+    return _size == 0;
+  }
+
+  std::size_t size() const
+  {
+    return _size;
+  }
+
+  // Configuration of the task that waits the longest
+  std::size_t oldest_config() const
+  {
+    std::size_t oldest = 0;
+    for (std::size_t i = 0; i < _configs.size(); i++) {
+      if (!_configs[i].tasks.empty() &&
+          (_configs[oldest].tasks.empty() ||
+           arrival(i) < arrival(oldest))) {
+        oldest = i;
+      }
+    }
+    return oldest;
+  }
+
+  // When the oldest task has to be run, whatever else is pending
+  TimePoint deadline(const ReorderPolicy& policy) const
+  {
+    if (empty()) {
+      return TimePoint::max();
+    }
+    if (_size >= policy.window) {
+      return TimePoint::min();
+    }
+    return arrival(oldest_config()) +
+           std::chrono::duration_cast<Clock::duration>(
+               std::chrono::duration<double>(policy.max_delay));
+  }
+
+  std::size_t next_config(TimePoint now, const ReorderPolicy& policy) const
+  {
+    if (now >= deadline(policy)) {
+      return oldest_config();
+    }
+    std::size_t best = oldest_config();
+    for (std::size_t i = 0; i < _configs.size(); i++) {
+      if (!_configs[i].tasks.empty() &&
+          _configs[i].work > _configs[best].work) {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+private:
+  struct Config {
+    std::deque<PendingTask> tasks;
+    double                  work = 0;
+  };
+
+  TimePoint arrival(std::size_t config) const
+  {
+    return _configs[config].tasks.front().task.created_at();
+  }
+
+  // Growing a deque never moves the pending tasks
+  std::deque<Config>  _configs;
+  std::size_t         _size = 0;
+};
+
+}  // namespace forecast
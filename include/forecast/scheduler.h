@@ -1,8 +1,12 @@
 #pragma once
 
 #include <CL/cl.hpp>
+#include <cmath>
 #include <condition_variable>
+#include <cstdlib>
 #include <functional>
+#include <limits>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -10,66 +14,341 @@
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/basic_file_sink.h"
 
+#include "cl_backend.h"
 #include "configuration.h"
+#include "granularity.h"
+#include "interference.h"
+#include "metrics.h"
+#include "model_store.h"
+#include "queue.h"
+#include "reorder.h"
 #include "task.h"
+#include "tracer.h"
 
-namespace forecast { class Scheduler { public: Scheduler(cl::Context* ctx) :
-  _ctx(ctx) , _current_config(nullptr) , _current_id(0) ,
-    _logger(std::make_unique<spdlog::logger>("file_logger",
-          std::make_unique<spdlog::sinks::basic_file_sink_st>("logs/scheduler.csv", true)))
+namespace forecast {
+
+// Index of a kernel registered with Scheduler::register_kernel
+using KernelHandle = uint32_t;
+
+// What add_task does with a task that cannot meet its deadline anymore
+enum class Admission { Accept, Warn, Reject };
+
+class Scheduler { public: Scheduler(cl::Context* ctx) :
+  Scheduler(std::make_unique<ClBackend>(ctx))
+  {
+  }
+
+  // An empty model_path disables loading and saving the models
+  Scheduler(
+      std::unique_ptr<Backend> backend,
+      const std::string&       model_path = model_store_path(),
+      const std::string&       log_path   = "logs/scheduler.csv")
+    : _backend(std::move(backend))
+    , _model_path(model_path)
+    , _current_config(nullptr)
+    , _current_id(0)
+    , _started_at(Clock::now())
+    , _logger(std::make_unique<spdlog::logger>(
+          "file_logger",
+          std::make_unique<spdlog::sinks::basic_file_sink_st>(
+              log_path, true)))
   {
     _logger->set_pattern("%v");
     _logger->info(
-        "id, config, kernel, flops, online, offline, log_online, actual");
+        "id, config, kernel, flops, online, offline, log_online, actual, "
+        "size, arrival, p95, p99");
+    // Handles index it without a lock, it must not reallocate
+    _kernels.reserve(max_kernels);
+    if (!_model_path.empty()) {
+      load_models(_model_path, device_identity(), _models);
+    }
+  }
+
+  ~Scheduler() {
+    wait();
+    if (_dispatcher.joinable()) {
+      {
+        std::lock_guard<std::mutex> lg(_dispatch_m);
+        _dispatch_stop = true;
+      }
+      _dispatch_cv.notify_all();
+      _dispatcher.join();
+    }
+    save_models();
   }
 
+  // Keeps the models, they stay valid for the next batch of tasks. Kernel
+  // handles have to be registered again.
   void reset() {
-    _queues.clear();
-    _models.clear();
+    std::lock_guard<std::mutex> lk(_kernels_m);
+    _kernels.clear();
+    _kernel_handles.clear();
+    _current_id = 0;
+    std::lock_guard<std::mutex> lg(_models_m);
     _current_config = nullptr;
-    _current_id     = 0;
+  }
+
+  bool save_models() {
+    if (_model_path.empty()) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lg(_models_m);
+    return forecast::save_models(_model_path, device_identity(), _models);
+  }
+
+  // Models are only valid for the board and driver they were learned on
+  std::string device_identity() const {
+    return _backend->identity();
+  }
+
+  Backend& backend() {
+    return *_backend;
+  }
+
+  // Bitstreams in the order they were added
+  const std::vector<std::string>& configs() const {
+    return _config_names;
   }
 
   void add_config(const std::string &bitstream)
   {
-    _configs.try_emplace(bitstream, bitstream, _ctx);
-    _models.try_emplace(bitstream, bitstream);
+    _configs.try_emplace(bitstream, bitstream, _backend.get());
+    if (_config_indices.try_emplace(bitstream, _config_names.size()).second) {
+      _config_names.push_back(bitstream);
+    }
+    {
+      std::lock_guard<std::mutex> lg(_models_m);
+      _models.try_emplace(bitstream, bitstream);
+    }
     if(_configs.size() == 1) {
-      _current_config = std::addressof(_configs.begin()->second);
+      set_config(bitstream);
+    }
+  }
+
+  /**
+   * Look up a kernel once and submit its tasks by handle, add_task by name
+   * looks it up for every task. Registering a kernel again returns the
+   * same handle. Any thread may register kernels while others submit, up
+   * to max_kernels of them.
+   */
+  KernelHandle register_kernel(const std::string &name)
+  {
+    std::lock_guard<std::mutex> lg(_kernels_m);
+    auto it = _kernel_handles.find(name);
+    if (it != _kernel_handles.end()) {
+      return it->second;
+    }
+    if (_kernels.size() == max_kernels) {
+      critical("More than {} kernels registered", max_kernels);
+      std::exit(1);
+    }
+    const auto handle = static_cast<KernelHandle>(_kernels.size());
+    auto       kernel = std::make_unique<Kernel>();
+    kernel->name      = intern(name);
+    kernel->metrics   = std::addressof(_metrics.kernel(name));
+    auto* k           = kernel.get();
+    kernel->queue     = std::make_unique<Queue>(
+        *_backend,
+        [this, k](Task& t) { task_done(*k, t); },
+        name,
+        k->metrics,
+        _queue_order);
+    kernel->queue->set_gate(_coscheduler.get());
+    _kernels.push_back(std::move(kernel));
+    _kernel_handles.emplace(name, handle);
+    return handle;
+  }
+
+  /**
+   * The task has to run the kernel the handle was registered for. Returns
+   * false if admission turned the task away because the model predicts it
+   * to finish after its deadline even if it started right away.
+   */
+  bool add_task(KernelHandle kernel, Task &&task)
+  {
+    assert(kernel < _kernels.size());
+    assert(task.interned_name() == _kernels[kernel]->name);
+    auto& k = *_kernels[kernel];
+    if (task.has_deadline() && !admit(k, task)) {
+      return false;
+    }
+    if (k.resize && k.granularity.split && !task.completion()) {
+      auto parts = split(k, task);
+      if (!parts.empty()) {
+        for (auto& part : parts) {
+          submit(k, std::move(part));
+        }
+        return true;
+      }
+    }
+    submit(k, std::move(task));
+    return true;
+  }
+
+  /**
+   * Split the kernel's long tasks and coalesce its short adjacent ones, see
+   * Granularity. The kernel has to tolerate launches on sub-ranges of its
+   * tasks, which granularity.offset_safe states. Without it every task is
+   * launched as submitted.
+   */
+  void set_granularity(KernelHandle kernel, Granularity granularity)
+  {
+    assert(kernel < _kernels.size());
+    auto* k = _kernels[kernel].get();
+    if (!granularity.offset_safe) {
+      warn(
+          "Not resizing the tasks of {}, it is not marked offset_safe",
+          *k->name);
+      return;
+    }
+    k->granularity = granularity;
+    k->resize      = true;
+    if (granularity.coalesce) {
+      k->queue->set_coalescer([this, k](Task& task, const Task& next) {
+        return coalesce_tasks(*k, task, next);
+      });
+    } else {
+      k->queue->set_coalescer(nullptr);
+    }
+  }
+
+  void set_granularity(const std::string& kernel, Granularity granularity)
+  {
+    set_granularity(register_kernel(kernel), granularity);
+  }
+
+  /**
+   * Let up to units kernels of the loaded bitstream run at the same time,
+   * paired by the slowdowns the models learn, see CoScheduler. Without it
+   * every kernel launches as soon as its queue has a task.
+   */
+  void enable_coscheduling(unsigned units = 2, uint64_t min_samples = 3)
+  {
+    // The queues keep a pointer to it
+    if (_coscheduler) {
+      return;
+    }
+    _coscheduler = std::make_unique<CoScheduler>(
+        units,
+        [this](const std::string& kernel, const std::string& other) {
+          std::lock_guard<std::mutex> lg(_models_m);
+          return _models.at(_current_config->bitstream())
+              .slowdown(kernel, other);
+        },
+        min_samples);
+    std::lock_guard<std::mutex> lg(_kernels_m);
+    for (auto& kernel : _kernels) {
+      kernel->queue->set_gate(_coscheduler.get());
+    }
+  }
+
+  // Deadline orders the queues by priority and slack, see TaskHeap
+  void set_queue_order(QueueOrder order)
+  {
+    std::lock_guard<std::mutex> lg(_kernels_m);
+    _queue_order = order;
+    for (auto& kernel : _kernels) {
+      kernel->queue->set_order(order);
     }
   }
 
-  void add_task(Task &&task)
+  void set_admission(Admission admission)
   {
-    const auto task_id = _current_id++;
-    task.set_id(task_id);
-    TaskCallback clb =
-        std::bind(&Scheduler::task_done, this, std::placeholders::_1);
-    auto& queue = _queues
-                      .try_emplace(
-                          task.function_name(),
-                          *_ctx,
-                          std::addressof(current_config().program()),
-                          std::move(clb))
-                      .first->second;
-    queue.enqueue(std::move(task));
+    _admission = admission;
+  }
+
+  /**
+   * Hold tasks back in a window and run them grouped by configuration, the
+   * scheduler switches configurations on its own from then on. A task runs
+   * on the configuration it was pinned to with Task::set_config, otherwise
+   * on the cheapest one that has parameters for its kernel.
+   */
+  void enable_reordering(ReorderPolicy policy = ReorderPolicy())
+  {
+    std::lock_guard<std::mutex> lg(_dispatch_m);
+    _policy = policy;
+    if (!_reordering) {
+      _reordering = true;
+      _dispatcher = std::thread(&Scheduler::dispatch_loop, this);
+    }
+  }
+
+  bool add_task(Task &&task)
+  {
+    return add_task(register_kernel(task.function_name()), std::move(task));
+  }
+
+  const Metrics& metrics() const
+  {
+    return _metrics;
+  }
+
+  Metrics& metrics()
+  {
+    return _metrics;
+  }
+
+  // Seconds the task is predicted to take on the configuration, by the
+  // online model once it has measured two sizes
+  float predict(const Task& task, const std::string& config)
+  {
+    std::lock_guard<std::mutex> lg(_models_m);
+    const auto prediction = _models.at(config).linreg(task);
+    const auto flop =
+        kernel_params(config, task.function_name()).flop(task.problem_size());
+    return prediction.alpha + prediction.beta * flop;
+  }
+
+  // p95 and p99 of the task's duration on the configuration, the mean
+  // prediction until its size has been measured
+  Tail predict_tail(const Task& task, const std::string& config)
+  {
+    std::lock_guard<std::mutex> lg(_models_m);
+    const auto& model = _models.at(config);
+    const auto  flop =
+        kernel_params(config, task.function_name()).flop(task.problem_size());
+    const auto mean = model.linreg(task);
+    return model.tail(task, flop, mean.alpha + mean.beta * flop);
+  }
+
+  // Called on the queue threads for every finished task
+  void set_completion_observer(std::function<void(const Task&)> observer)
+  {
+    _observer = std::move(observer);
   }
 
   Configuration& current_config()
   {
+    std::lock_guard<std::mutex> lg(_models_m);
     return *_current_config;
   }
 
+  // The dispatcher switches configurations while other threads predict on
+  // the current one, which they read under _models_m
   void set_config(const std::string &name) {
-    _current_config = std::addressof(_configs.at(name));
-    for (auto &queue : _queues) {
-      queue.second.set_program(std::addressof(_current_config->program()));
+    const auto begin = Clock::now();
+    {
+      std::lock_guard<std::mutex> lg(_models_m);
+      if (_current_config && _current_config->bitstream() != name) {
+        _metrics.config(name).reconfigurations.fetch_add(
+            1, std::memory_order_relaxed);
+      }
+      _current_config       = std::addressof(_configs.at(name));
+      _current_config_index = _config_indices.at(name);
     }
+    _backend->activate(name);
+    tracer().span(
+        "set_config", "reconfiguration", begin, Clock::now(), 0, name);
   }
 
   void wait() {
-    for(auto &queue : _queues) {
-      queue.second.wait();
+    if (_reordering) {
+      std::unique_lock<std::mutex> lk(_dispatch_m);
+      _dispatch_cv.wait(
+          lk, [this]() { return _window.empty() && _in_flight == 0; });
+    }
+    for (auto* kernel : kernels()) {
+      kernel->queue->wait();
     }
   }
 
@@ -79,46 +358,350 @@ namespace forecast { class Scheduler { public: Scheduler(cl::Context* ctx) :
   }
 
   std::size_t size() const {
+    const auto k = kernels();
     return std::accumulate(
-        _queues.begin(), _queues.end(), 0, [](std::size_t sum, const auto& queue) {
-          return sum + queue.second.size();
+        k.begin(), k.end(), 0, [](std::size_t sum, const auto* kernel) {
+          return sum + kernel->queue->size();
         });
   }
 
-  void task_done(Task t) {
-    auto params =
-        kernel_params(_current_config->bitstream(), t.function_name());
-    const auto  total      = t.global()[0] * t.global()[1];
-    auto        total_flop = params.flop(total);
-    auto& model = _models.at(_current_config->bitstream());
-    Measurement measurement{t.duration().count(), total_flop};
-    model.add_measurement(t, measurement);
-    auto linreg  = model.linreg(t);
+  static constexpr std::size_t max_kernels = 1024;
+
+private:
+  // What a kernel needs under one configuration, resolved on first use
+  struct Binding {
+    Model*           model          = nullptr;
+    const ParamSlot* params_slot    = nullptr;
+    Statistics*      statistics     = nullptr;
+    ConfigMetrics*   config_metrics = nullptr;
+
+    // The current parameters, set_kernel_params may replace them
+    const KernelParams& params() const
+    {
+      return params_slot->get();
+    }
+  };
+
+  struct Kernel {
+    const std::string*     name    = nullptr;
+    KernelMetrics*         metrics = nullptr;
+    // Indexed by the configuration index
+    std::vector<Binding>   bindings;
+    std::unique_ptr<Queue> queue;
+    // See set_granularity
+    bool                   resize = false;
+    Granularity            granularity;
+  };
+
+  void submit(Kernel& kernel, Task&& task)
+  {
+    task.set_id(_current_id++);
+    if (_reordering) {
+      hold(kernel, std::move(task));
+      return;
+    }
+    kernel.queue->enqueue(std::move(task));
+  }
+
+  // Requires _models_m. Seconds the kernel takes for flop with the size of
+  // the task in its prediction. Without a slope the task's own prediction is
+  // scaled, kernels without FLOPs are not predicted for other sizes.
+  double predict_flop(Binding& b, const Task& task, double flop)
+  {
+    const auto prediction =
+        b.model->linreg(*b.statistics, b.params(), task);
+    if (prediction.beta > 0) {
+      return prediction.alpha + prediction.beta * flop;
+    }
+    const auto own = b.params().flop(task.problem_size());
+    return own > 0 ? prediction.alpha * flop / own
+                   : std::numeric_limits<double>::max();
+  }
+
+  // Chunks of a task predicted to take longer than two of them, empty to
+  // launch it as is
+  std::vector<Task> split(Kernel& kernel, Task& task)
+  {
+    const auto&                 g = kernel.granularity;
+    std::lock_guard<std::mutex> lg(_models_m);
+    auto&                       b = binding(kernel);
+    if (task.predicted() <= 0) {
+      task.set_predicted(predict_flop(
+          b, task, b.params().flop(task.problem_size())));
+    }
+    if (task.predicted() <= 2 * g.chunk_seconds) {
+      return {};
+    }
+    const auto chunks = std::min<double>(
+        g.max_chunks, std::ceil(task.predicted() / g.chunk_seconds));
+    return split_task(task, static_cast<std::size_t>(chunks), b.params());
+  }
+
+  // Called on the queue thread, see Coalescer
+  bool coalesce_tasks(Kernel& kernel, Task& task, const Task& next)
+  {
+    if (!can_coalesce(task, next)) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lg(_models_m);
+    auto&                       b      = binding(kernel);
+    const auto&                 params = b.params();
+    const auto                  flop   = params.flop(task.problem_size()) +
+                       params.flop(next.problem_size());
+    if (predict_flop(b, task, flop) > kernel.granularity.chunk_seconds) {
+      return false;
+    }
+    coalesce(task, next, params);
+    return true;
+  }
+
+  void task_done(Kernel& kernel, Task& t) {
+    // Before taking _models_m, the co-scheduler takes it under its own lock
+    const auto corun =
+        _coscheduler ? _coscheduler->corun(kernel.name) : CoRun{};
+    // Failed launches teach the models nothing
+    if (t.status() == CL_SUCCESS) {
+      log_task(kernel, t, corun);
+    }
+    if (t.completion()) {
+      t.completion()(t);
+    }
+    if (_observer) {
+      _observer(t);
+    }
+    if (_reordering) {
+      {
+        std::lock_guard<std::mutex> lg(_dispatch_m);
+        _in_flight -= t.merged();
+      }
+      _dispatch_cv.notify_all();
+    }
+  }
+
+  // Predicts the duration on the configuration the task is pinned to, else
+  // the loaded one, and stores it in the task, the queue orders by it
+  bool admit(Kernel& kernel, Task& task)
+  {
+    {
+      std::lock_guard<std::mutex> lg(_models_m);
+      auto index = _current_config_index;
+      if (task.config()) {
+        const auto it = _config_indices.find(*task.config());
+        if (it != _config_indices.end()) {
+          index = it->second;
+        }
+      }
+      auto&       b          = binding(kernel, index);
+      const auto  prediction =
+          b.model->linreg(*b.statistics, b.params(), task);
+      const auto  flop       = b.params().flop(task.problem_size());
+      task.set_predicted(prediction.alpha + prediction.beta * flop);
+    }
+    if (task.latest_start() >= Clock::now() ||
+        _admission == Admission::Accept) {
+      return true;
+    }
+    if (_admission == Admission::Warn) {
+      warn(
+          "Task {} is predicted to miss its deadline ({}s)",
+          task.function_name(),
+          task.predicted());
+      return true;
+    }
+    kernel.metrics->rejected.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Configuration predicted to run the task fastest, with the prediction
+  std::pair<std::size_t, float> target_config(
+      const Kernel& kernel, const Task& task)
+  {
+    std::lock_guard<std::mutex> lg(_models_m);
+    std::size_t best      = _current_config_index;
+    float       best_cost = std::numeric_limits<float>::max();
+    for (std::size_t i = 0; i < _config_names.size(); i++) {
+      const auto& name = _config_names[i];
+      if (task.config() ? *task.config() != name
+                        : !has_kernel_params(name, *kernel.name)) {
+        continue;
+      }
+      const auto cost = _models.at(name).cost(task);
+      if (cost < best_cost) {
+        best      = i;
+        best_cost = cost;
+      }
+    }
+    if (best_cost == std::numeric_limits<float>::max()) {
+      best_cost = 0;
+    }
+    return {best, best_cost};
+  }
+
+  void hold(Kernel& kernel, Task&& task)
+  {
+    const auto target = target_config(kernel, task);
+    {
+      std::lock_guard<std::mutex> lg(_dispatch_m);
+      _window.push(PendingTask{
+          std::move(task), kernel.queue.get(), target.first, target.second});
+    }
+    _dispatch_cv.notify_all();
+  }
+
+  /**
+   * Releases the held tasks of the loaded configuration. Once the device
+   * has drained and only tasks of other configurations are left, it loads
+   * the next one. Tasks of the loaded configuration are held back as well
+   * when the oldest task waits for another one for too long.
+   */
+  void dispatch_loop()
+  {
+    pin_current_thread(_backend->numa_node());
+    std::unique_lock<std::mutex> lk(_dispatch_m);
+    while (!_dispatch_stop) {
+      const auto now     = Clock::now();
+      const auto current = current_config_index();
+      const bool overdue = now >= _window.deadline(_policy) &&
+                           _window.oldest_config() != current;
+      if (!overdue) {
+        _window.release(current, [this](PendingTask&& p) {
+          _in_flight++;
+          p.queue->enqueue(std::move(p.task));
+        });
+      }
+      if (_in_flight == 0 && !_window.empty()) {
+        set_config(_config_names[_window.next_config(now, _policy)]);
+        continue;
+      }
+      if (_window.empty() || overdue) {
+        _dispatch_cv.wait(lk);
+      } else {
+        Clock::wait_until(_dispatch_cv, lk, _window.deadline(_policy));
+      }
+    }
+  }
+
+  std::size_t current_config_index() {
+    std::lock_guard<std::mutex> lg(_models_m);
+    return _current_config_index;
+  }
+
+  // The registered kernels, while others register
+  std::vector<Kernel*> kernels() const {
+    std::lock_guard<std::mutex> lg(_kernels_m);
+    std::vector<Kernel*>        k;
+    for (const auto& kernel : _kernels) {
+      k.push_back(kernel.get());
+    }
+    return k;
+  }
+
+  // Requires _models_m
+  Binding& binding(Kernel& kernel) {
+    return binding(kernel, _current_config_index);
+  }
+
+  // Requires _models_m
+  Binding& binding(Kernel& kernel, std::size_t index) {
+    if (kernel.bindings.size() <= index) {
+      kernel.bindings.resize(index + 1);
+    }
+    auto& b = kernel.bindings[index];
+    if (!b.model) {
+      const auto& config = _config_names[index];
+      b.model            = std::addressof(_models.at(config));
+      b.params_slot =
+          std::addressof(kernel_param_slot(config, *kernel.name));
+      b.statistics =
+          std::addressof(b.model->kernel_statistics(*kernel.name));
+      b.config_metrics = std::addressof(_metrics.config(config));
+    }
+    return b;
+  }
+
+  void log_task(Kernel& kernel, const Task& t, const CoRun& corun) {
+    std::lock_guard<std::mutex> lg(_models_m);
+    auto&       b          = binding(kernel);
+    auto&       model      = *b.model;
+    const auto  total      = t.problem_size();
+    const auto  total_flop = b.params().flop(total);
+
+    // Error of the prediction the scheduler had before the task ran
+    const auto prior     = model.linreg(*b.statistics, b.params(), t);
+    const auto predicted = prior.alpha + prior.beta * total_flop;
+    const auto actual    = t.duration().count();
+    const auto tail      = model.tail(t, total_flop, predicted);
+    if (actual > 0) {
+      const auto error = std::abs(predicted - actual) / actual;
+      kernel.metrics->model_error.record(static_cast<uint64_t>(error * 1e6));
+    }
+    b.config_metrics->completed.fetch_add(1, std::memory_order_relaxed);
+
+    // Only runs alone describe the kernel itself, runs next to another
+    // kernel for the most part teach the slowdown of the pair
+    if (corun.overlap == 0) {
+      Measurement measurement{actual, total_flop};
+      b.statistics->add(measurement);
+      model.add_tail(t, total_flop, actual);
+    } else if (
+        corun.overlap >= 0.5 && b.statistics->n >= 2 && predicted > 0) {
+      model.add_slowdown(*kernel.name, *corun.other, actual / predicted);
+    }
+    auto linreg  = model.linreg(*b.statistics, b.params(), t);
     auto online  = linreg.alpha + linreg.beta * total_flop;
-    auto offline = model.cost(t);
-    auto simple_linreg = model.simple_linreg(t);
+    auto offline = model.cost(b.params(), t);
+    auto simple_linreg = model.simple_linreg(*b.statistics, b.params(), t);
     auto hybrid = model.offline_alpha + simple_linreg.beta * total_flop;
 
+    const std::chrono::duration<double> arrival = t.created_at() - _started_at;
+
     _logger->info(
-        "{}, {}, {}, {}, {}, {}, {}, {}",
+        "{}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}",
         t.id(),
-        _current_config->bitstream(),
-        t.function_name(),
+        model.config(),
+        *kernel.name,
         total_flop,
         online,
         offline,
         hybrid,
-        t.duration().count());
+        t.duration().count(),
+        total,
+        arrival.count(),
+        tail.p95,
+        tail.p99);
   }
 
-private:
-  cl::Context*                         _ctx;
+  std::unique_ptr<Backend>             _backend;
+  std::string                          _model_path;
   std::map<std::string, Configuration> _configs;
   std::map<std::string, Model>         _models;
+  std::mutex                           _models_m;
 
+  std::map<std::string, std::size_t>   _config_indices;
+  std::vector<std::string>             _config_names;
   Configuration*                       _current_config;
+  std::size_t                          _current_config_index = 0;
   uint64_t                             _current_id;
-  std::map<std::string, Queue>         _queues;
+  TimePoint                            _started_at;
+  Metrics                              _metrics;
+  std::function<void(const Task&)>     _observer;
   std::unique_ptr<spdlog::logger>      _logger;
+  std::map<std::string, KernelHandle>  _kernel_handles;
+  QueueOrder                           _queue_order = QueueOrder::Fifo;
+  Admission                            _admission   = Admission::Warn;
+  // Reordering, see enable_reordering
+  std::mutex                           _dispatch_m;
+  std::condition_variable              _dispatch_cv;
+  bool                                 _reordering    = false;
+  bool                                 _dispatch_stop = false;
+  ReorderPolicy                        _policy;
+  ReorderWindow                        _window;
+  std::size_t                          _in_flight = 0;
+  std::thread                          _dispatcher;
+  std::unique_ptr<CoScheduler>         _coscheduler;
+  // Guards registration, see register_kernel
+  mutable std::mutex                   _kernels_m;
+  // Last, the queue threads finish before anything else is destroyed
+  std::vector<std::unique_ptr<Kernel>> _kernels;
 };
 }
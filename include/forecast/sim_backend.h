@@ -0,0 +1,298 @@
+#pragma once
+
+#include "backend.h"
+#include "model.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace forecast {
+
+struct SimParams {
+  // Seconds to load a different bitstream
+  double reconfiguration = 1.5;
+  // Kernels that can run at the same time
+  unsigned compute_units = 1;
+  // Bytes per second of host<->device copies, 0 uses the calibrated link
+  double transfer_bandwidth = 0;
+  // Bytes per second of device memory shared by kernels that run at the
+  // same time, 0 lets them run without interfering
+  double memory_bandwidth = 0;
+  // Share of memory_bandwidth lost while concurrent kernels ask for more
+  // than it, e.g. to bank and row conflicts
+  double contention = 0.4;
+  // Relative standard deviation of kernel durations
+  double noise = 0;
+  // Clock seconds per simulated second, < 1 runs faster than real time
+  double time_scale = 1;
+  unsigned seed = 42;
+};
+
+/**
+ * A device without hardware. Kernel durations follow the KernelParams
+ * roofline of the active bitstream, switching bitstreams waits for the
+ * device to drain and then costs the reconfiguration latency. Durations
+ * are scaled by time_scale, so the measurements the scheduler takes are in
+ * scaled time as well. Speeding up the Clock instead keeps them in
+ * simulated seconds, see Simulator. With a memory_bandwidth, concurrent
+ * kernels that ask for more bandwidth than that together slow each other
+ * down.
+ */
+class SimBackend : public Backend {
+public:
+  SimBackend(SimParams params = SimParams())
+    : _params(params)
+    , _rng(params.seed)
+  {
+  }
+
+  void prepare(const std::string& bitstream) override
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    _models.try_emplace(bitstream, bitstream);
+  }
+
+  void activate(const std::string& bitstream) override
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    _active = bitstream;
+  }
+
+  std::unique_ptr<Stream> create_stream() override;
+
+  std::string identity() const override
+  {
+    return "simulated";
+  }
+
+  const SimParams& params() const
+  {
+    return _params;
+  }
+
+  /**
+   * Take the seconds of every task from durations instead of the roofline,
+   * e.g. to replay the durations of a recorded trace. Set it before the
+   * first task.
+   */
+  void set_durations(
+      std::function<double(const std::string&, const Task&)> durations)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    _durations = std::move(durations);
+  }
+
+  // Seconds the task takes with the given bitstream, including noise
+  double duration(const std::string& bitstream, const Task& task)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    if (_durations) {
+      return _durations(bitstream, task);
+    }
+    const auto& model  = _models.at(bitstream);
+    double      kernel = model.kernel_cost(task);
+    if (_params.noise > 0) {
+      std::normal_distribution<double> noise(1, _params.noise);
+      kernel *= std::max(0.0, noise(_rng));
+    }
+    double transfer = model.transfer_cost(task.transfer_bytes());
+    if (_params.transfer_bandwidth > 0 && task.transfer_bytes() > 0) {
+      transfer = task.transfer_bytes() / _params.transfer_bandwidth;
+    }
+    return kernel + transfer;
+  }
+
+  // Global memory bytes the task's kernel moves with the given bitstream
+  double bytes(const std::string& bitstream, const Task& task) const
+  {
+    return kernel_params(bitstream, task.function_name())
+        .bytes(task.problem_size());
+  }
+
+  std::string active() const
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    return _active;
+  }
+
+  /**
+   * Occupy a compute unit for the given (simulated) seconds, longer if it
+   * has to share the memory bandwidth. Reconfigures first if the bitstream
+   * is not loaded, which requires an idle device. Returns when the kernel
+   * started.
+   */
+  TimePoint execute(
+      const std::string& bitstream, double seconds, double bytes = 0)
+  {
+    std::unique_lock<std::mutex> lk(_m);
+    _cv.wait(lk, [this, &bitstream]() {
+      return not _reconfiguring && _busy < _params.compute_units &&
+             (_loaded == bitstream || _busy == 0);
+    });
+    if (_loaded != bitstream) {
+      _reconfiguring = true;
+      lk.unlock();
+      const auto begin = Clock::now();
+      sleep(_params.reconfiguration);
+      tracer().span(
+          "reconfigure", "reconfiguration", begin, Clock::now(), 0, bitstream);
+      lk.lock();
+      _loaded        = bitstream;
+      _reconfiguring = false;
+      _reconfigurations++;
+    }
+    _busy++;
+    const auto started = Clock::now();
+    if (_params.memory_bandwidth > 0 && _params.time_scale > 0) {
+      share(seconds, seconds > 0 ? bytes / seconds : 0, lk);
+    } else {
+      lk.unlock();
+      sleep(seconds);
+      lk.lock();
+    }
+    _busy--;
+    lk.unlock();
+    _cv.notify_all();
+    return started;
+  }
+
+  std::size_t reconfigurations() const
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    return _reconfigurations;
+  }
+
+private:
+  // Requires _m. Progress of all running kernels slows down evenly while
+  // they ask for more than the memory bandwidth, a kernel alone always runs
+  // at its own speed.
+  double rate() const
+  {
+    double demand = 0;
+    for (auto d : _demands) {
+      demand += d;
+    }
+    if (_demands.size() < 2 || demand <= _params.memory_bandwidth) {
+      return 1;
+    }
+    return _params.memory_bandwidth * (1 - _params.contention) / demand;
+  }
+
+  // Requires _m, which is held on return. Runs the kernel in steps between
+  // the start and end of others, every one of them changes the rate.
+  void share(double seconds, double demand, std::unique_lock<std::mutex>& lk)
+  {
+    auto it = _demands.insert(_demands.end(), demand);
+    _cv.notify_all();
+    auto last      = Clock::now();
+    auto remaining = seconds;
+    while (remaining > 0) {
+      const auto r = rate();
+      Clock::wait_until(
+          _cv,
+          lk,
+          last + std::chrono::duration_cast<Clock::duration>(
+                     std::chrono::duration<double>(
+                         remaining / r * _params.time_scale)));
+      const auto                          now     = Clock::now();
+      const std::chrono::duration<double> elapsed = now - last;
+      remaining -= elapsed.count() / _params.time_scale * r;
+      last = now;
+    }
+    _demands.erase(it);
+  }
+
+  void sleep(double seconds) const
+  {
+    const auto scaled = seconds * _params.time_scale;
+    if (scaled > 0) {
+      Clock::sleep_until(
+          Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                             std::chrono::duration<double>(scaled)));
+    }
+  }
+
+  SimParams                    _params;
+  mutable std::mutex           _m;
+  std::condition_variable      _cv;
+  std::mt19937                 _rng;
+  std::map<std::string, Model> _models;
+  std::function<double(const std::string&, const Task&)> _durations;
+  std::string                  _active;
+  std::string                  _loaded;
+  bool                         _reconfiguring    = false;
+  unsigned                     _busy             = 0;
+  // Bytes per second of the running kernels
+  std::list<double>            _demands;
+  std::size_t                  _reconfigurations = 0;
+};
+
+class SimStream : public Stream {
+public:
+  SimStream(SimBackend& backend)
+    : _backend(backend)
+  {
+  }
+
+  void launch(Task& task) override
+  {
+    _bitstream = _backend.active();
+    _seconds   = _backend.duration(_bitstream, task);
+    _bytes     = _backend.bytes(_bitstream, task);
+    task.enqueued_now();
+  }
+
+  void wait(Task& task) override
+  {
+    task.set_started_at(_backend.execute(_bitstream, _seconds, _bytes));
+  }
+
+private:
+  SimBackend& _backend;
+  std::string _bitstream;
+  double      _seconds = 0;
+  double      _bytes   = 0;
+};
+
+std::unique_ptr<Stream> SimBackend::create_stream()
+{
+  return std::make_unique<SimStream>(*this);
+}
+
+// Runs nothing, for measuring the host side of the scheduler
+class NullBackend : public Backend {
+public:
+  class NullStream : public Stream {
+  public:
+    void launch(Task& task) override
+    {
+      task.enqueued_now();
+    }
+
+    void wait(Task&) override {}
+  };
+
+  void prepare(const std::string&) override {}
+
+  void activate(const std::string&) override {}
+
+  std::unique_ptr<Stream> create_stream() override
+  {
+    return std::make_unique<NullStream>();
+  }
+
+  std::string identity() const override
+  {
+    return "null";
+  }
+};
+
+}  // namespace forecast
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "model.h"
+#include "parameters.h"
+#include "scheduler.h"
+#include "sim_backend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <log.h>
+
+namespace forecast {
+
+// One task of a scheduler trace, as logged by Scheduler::task_done
+struct TraceEntry {
+  uint64_t    id = 0;
+  std::string config;
+  std::string kernel;
+  double      flops = 0;
+  std::size_t size  = 0;
+  // Seconds since the start of the trace
+  double arrival = 0;
+  // Seconds on the device
+  double duration = 0;
+};
+
+using Trace = std::vector<TraceEntry>;
+
+std::vector<std::string> split_csv_line(const std::string& line)
+{
+  std::vector<std::string> fields;
+  std::stringstream        ss(line);
+  std::string              field;
+  while (std::getline(ss >> std::ws, field, ',')) {
+    field.erase(field.find_last_not_of(" \t\r") + 1);
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+/**
+ * Read a trace in the format of logs/scheduler.csv. Traces written before
+ * the arrival column existed replay as if all tasks arrived at once.
+ */
+Trace read_trace(const std::string& path)
+{
+  std::ifstream in(path);
+  std::string   line;
+  Trace         trace;
+  if (!std::getline(in, line)) {
+    warn("Empty trace {}", path);
+    return trace;
+  }
+
+  std::map<std::string, std::size_t> column;
+  const auto                         header = split_csv_line(line);
+  for (std::size_t i = 0; i < header.size(); i++) {
+    column[header[i]] = i;
+  }
+  for (const auto* required : {"config", "kernel", "flops", "actual"}) {
+    if (!column.count(required)) {
+      warn("Trace {} has no column {}", path, required);
+      return trace;
+    }
+  }
+
+  while (std::getline(in, line)) {
+    const auto fields = split_csv_line(line);
+    if (fields.size() < header.size()) {
+      continue;
+    }
+    bool valid = true;
+    auto value = [&](const char* name, double fallback) {
+      auto   it     = column.find(name);
+      double parsed = fallback;
+      if (it != column.end() && !parse_double(fields[it->second], parsed)) {
+        valid = false;
+      }
+      return parsed;
+    };
+    TraceEntry entry;
+    entry.id       = value("id", trace.size());
+    entry.config   = fields[column["config"]];
+    entry.kernel   = fields[column["kernel"]];
+    entry.flops    = value("flops", 0);
+    entry.size     = value("size", 0);
+    entry.arrival  = value("arrival", 0);
+    entry.duration = value("actual", 0);
+    if (!valid) {
+      warn("Skipping malformed line of {}: {}", path, line);
+      continue;
+    }
+    trace.push_back(entry);
+  }
+
+  std::stable_sort(trace.begin(), trace.end(), [](auto& a, auto& b) {
+    return a.arrival < b.arrival;
+  });
+  return trace;
+}
+
+struct TraceKernel {
+  std::string config;
+  std::string kernel;
+  std::size_t size;
+  double      probability;
+};
+
+/**
+ * Generate a trace with Poisson arrivals at rate tasks per second (all at
+ * once if rate is 0) and durations from the offline model with relative
+ * noise.
+ */
+Trace synthetic_trace(
+    const std::vector<TraceKernel>& kernels,
+    std::size_t                     tasks,
+    double                          rate,
+    double                          noise = 0.05,
+    unsigned                        seed  = 42)
+{
+  std::mt19937                     rng(seed);
+  std::normal_distribution<double> jitter(1, noise);
+  std::vector<double>              weights;
+  for (const auto& k : kernels) {
+    weights.push_back(k.probability);
+  }
+  std::discrete_distribution<std::size_t> pick(weights.begin(), weights.end());
+
+  Trace  trace;
+  double now = 0;
+  for (std::size_t i = 0; i < tasks; i++) {
+    if (rate > 0) {
+      now += std::exponential_distribution<double>(rate)(rng);
+    }
+    const auto& k = kernels[pick(rng)];
+    Task        task(k.kernel, {});
+    task.set_problem_size(k.size);
+
+    TraceEntry entry;
+    entry.id       = i;
+    entry.config   = k.config;
+    entry.kernel   = k.kernel;
+    entry.size     = k.size;
+    entry.flops    = kernel_params(k.config, k.kernel).flop(k.size);
+    entry.arrival  = now;
+    entry.duration = Model(k.config).cost(task) * std::max(0.0, jitter(rng));
+    trace.push_back(entry);
+  }
+  return trace;
+}
+
+struct SimulationReport {
+  std::size_t tasks            = 0;
+  std::size_t reconfigurations = 0;
+  double      makespan         = 0;
+  // Arrival to completion, in seconds
+  double latency_p50 = 0;
+  double latency_p90 = 0;
+  double latency_p99 = 0;
+  double latency_max = 0;
+  // Mean absolute relative error of the predictions made before each task
+  double online_error  = 0;
+  double offline_error = 0;
+
+  template <typename OStream>
+  friend OStream& operator<<(OStream& os, const SimulationReport& r)
+  {
+    return os << r.tasks << " tasks, makespan " << r.makespan
+              << "s, latency p50/p90/p99/max " << r.latency_p50 << "/"
+              << r.latency_p90 << "/" << r.latency_p99 << "/"
+              << r.latency_max << "s, " << r.reconfigurations
+              << " reconfigurations, prediction error online "
+              << r.online_error * 100 << "% offline "
+              << r.offline_error * 100 << "%";
+  }
+};
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+  if (sorted.empty()) {
+    return 0;
+  }
+  const auto rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+}
+
+/**
+ * Replay of a trace through a Scheduler on a SimBackend, on a Clock that
+ * runs speedup times as fast as the wall clock. Tasks arrive at the times
+ * of the trace, pinned to its configuration, and take the duration it
+ * recorded, everything in between is the scheduler's own policy. Its host
+ * overheads are sped up with the rest, so they count speedup times over.
+ */
+class Simulator {
+public:
+  Simulator(
+      double      reconfiguration = 1.5,
+      double      speedup         = 1000,
+      std::string log_path        = "logs/simulator.csv")
+    : _reconfiguration(reconfiguration)
+    , _speedup(speedup)
+    , _log_path(std::move(log_path))
+  {
+  }
+
+  // Offline model of a configuration, to compare the scheduler's with
+  Model& model(const std::string& config)
+  {
+    return _models.try_emplace(config, config).first->second;
+  }
+
+  // setup configures the scheduler before the first task, e.g. its policy
+  SimulationReport run(
+      const Trace&                           trace,
+      const std::function<void(Scheduler&)>& setup = nullptr)
+  {
+    SimulationReport report;
+    report.tasks = trace.size();
+    if (trace.empty()) {
+      return report;
+    }
+
+    SimParams params;
+    params.reconfiguration = _reconfiguration;
+    auto  backend          = std::make_unique<SimBackend>(params);
+    auto* device           = backend.get();
+    // The scheduler numbers the tasks in the order of add_task
+    device->set_durations([&trace](const std::string&, const Task& task) {
+      return task.id() < trace.size() ? trace[task.id()].duration : 0;
+    });
+    Scheduler scheduler(std::move(backend), "", _log_path);
+    for (const auto& entry : trace) {
+      scheduler.add_config(entry.config);
+    }
+    // Tasks only wait for the configuration they are pinned to with it
+    scheduler.enable_reordering();
+    if (setup) {
+      setup(scheduler);
+    }
+
+    std::vector<TimePoint> arrived(trace.size());
+    std::vector<TimePoint> finished(trace.size(), TimePoint::min());
+    double                 offline_error = 0;
+    std::size_t            predictions   = 0;
+
+    Clock::set_rate(_speedup);
+    const auto start = Clock::now();
+    for (std::size_t i = 0; i < trace.size(); i++) {
+      const auto& entry = trace[i];
+      Clock::sleep_until(
+          start + std::chrono::duration_cast<Clock::duration>(
+                      std::chrono::duration<double>(
+                          entry.arrival - trace.front().arrival)));
+      Task task(entry.kernel, {});
+      task.set_problem_size(entry.size);
+      task.set_config(entry.config);
+      task.set_completion(
+          [&finished, i](const Task&) { finished[i] = Clock::now(); });
+      if (entry.duration > 0) {
+        offline_error += std::abs(model(entry.config).cost(task) -
+                                  entry.duration) /
+                         entry.duration;
+        predictions++;
+      }
+      arrived[i] = Clock::now();
+      scheduler.add_task(std::move(task));
+    }
+    scheduler.wait();
+    Clock::set_rate(1);
+
+    std::vector<double> latencies;
+    auto                end = start;
+    for (std::size_t i = 0; i < trace.size(); i++) {
+      if (finished[i] == TimePoint::min()) {
+        continue;
+      }
+      const std::chrono::duration<double> latency = finished[i] - arrived[i];
+      latencies.push_back(latency.count());
+      end = std::max(end, finished[i]);
+    }
+
+    // The scheduler records the error of the prediction it had before
+    // each task in millionths
+    uint64_t error = 0, errors = 0;
+    for (const auto& kernel : scheduler.metrics().snapshot().kernels) {
+      error += kernel.second.model_error.sum;
+      errors += kernel.second.model_error.count;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const std::chrono::duration<double> makespan = end - start;
+    report.tasks            = latencies.size();
+    report.reconfigurations = device->reconfigurations();
+    report.makespan         = makespan.count();
+    report.latency_p50      = percentile(latencies, 0.5);
+    report.latency_p90      = percentile(latencies, 0.9);
+    report.latency_p99      = percentile(latencies, 0.99);
+    report.latency_max = latencies.empty() ? 0 : latencies.back();
+    if (errors > 0) {
+      report.online_error = error / 1e6 / errors;
+    }
+    if (predictions > 0) {
+      report.offline_error = offline_error / predictions;
+    }
+    return report;
+  }
+
+private:
+  double                       _reconfiguration;
+  double                       _speedup;
+  std::string                  _log_path;
+  std::map<std::string, Model> _models;
+};
+
+}  // namespace forecast
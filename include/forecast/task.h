@@ -1,17 +1,23 @@
 #pragma once
 
+#include "clock.h"
+
 #include <CL/cl.hpp>
 #include <chrono>
 #include <deque>
 #include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
 #include "spdlog/fmt/ostr.h"
 
 namespace forecast {
 
-using Clock     = std::chrono::high_resolution_clock;
-using TimePoint = std::chrono::time_point<Clock>;
+using TimePoint = Clock::time_point;
 using KernelGen = std::function<cl::Kernel(const cl::Program&, const std::string&)>;
 class Scheduler;
+class Task;
+using Completion = std::function<void(const Task&)>;
 
 struct TaskDims {
   TaskDims()
@@ -26,6 +32,13 @@ struct TaskDims {
   {
   }
 
+  // Leaves the local size to the autotuner, see autotune.h
+  explicit TaskDims(cl::NDRange g)
+    : global(g)
+    , local(cl::NullRange)
+  {
+  }
+
   template <typename OStream>
   friend OStream& operator<<(OStream& os, const TaskDims& c)
   {
@@ -39,19 +52,61 @@ struct TaskDims {
   cl::NDRange offset = cl::NullRange;
 };
 
-class Task {
+// Higher classes run first on a queue ordered by QueueOrder::Deadline
+enum class Priority : uint8_t { Background, Normal, Urgent };
+
+// Problem sizes within a factor of two share their tuning and tail sketches
+std::size_t size_bucket(std::size_t problem_size)
+{
+  std::size_t bucket = 0;
+  while (problem_size > 1) {
+    problem_size >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+// Kernel names live as long as the program, tasks only point to them
+const std::string* intern(const std::string& name)
+{
+  static std::mutex                      m;
+  static std::unordered_set<std::string> names;
+  std::lock_guard<std::mutex>            lg(m);
+  return std::addressof(*names.insert(name).first);
+}
+
+/**
+ * A kernel launch. Tasks are move-only and the fields touched on every step
+ * of the pipeline share the first cache line, the kernel and its arguments
+ * are only needed on launch.
+ */
+class alignas(64) Task {
 public:
   Task(
       const std::string& function_name,
       KernelGen          kernel_gen,
       TaskDims           dims = TaskDims())
-    : _created_at(Clock::now()) // we construct the task in-place
-    , _function_name(function_name)
-    , _kernel_gen(kernel_gen)
+    : Task(intern(function_name), std::move(kernel_gen), dims)
+  {
+  }
+
+  // Skips interning, for names from intern()
+  Task(
+      const std::string* interned_name,
+      KernelGen          kernel_gen,
+      TaskDims           dims = TaskDims())
+    : _function_name(interned_name)
+    , _created_at(Clock::now()) // we construct the task in-place
+    , _kernel_gen(std::move(kernel_gen))
     , _dims(dims)
   {
   }
 
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  Task(Task&&)                 = default;
+  Task& operator=(Task&&) = default;
+
   uint64_t id() const
   {
     return _id;
@@ -69,7 +124,7 @@ public:
 
   cl::Kernel& generate_kernel(const cl::Program& prg)
   {
-    _kernel = _kernel_gen(prg, _function_name);
+    _kernel = _kernel_gen(prg, *_function_name);
     return _kernel;
   }
 
@@ -82,9 +137,32 @@ public:
     return _kernel_done;
   }
 
+  TimePoint created_at() const
+  {
+    return _created_at;
+  }
+
   void enqueued_now()
   {
     _enqueued_at = Clock::now();
+    _started_at  = _enqueued_at;
+  }
+
+  TimePoint enqueued_at() const
+  {
+    return _enqueued_at;
+  }
+
+  // When the device began the kernel, the enqueue time unless the stream
+  // knows better
+  TimePoint started_at() const
+  {
+    return _started_at;
+  }
+
+  void set_started_at(TimePoint started_at)
+  {
+    _started_at = started_at;
   }
 
   void finished_now()
@@ -92,10 +170,72 @@ public:
     _finished_at = Clock::now();
   }
 
-  std::string function_name() const {
+  TimePoint finished_at() const
+  {
+    return _finished_at;
+  }
+
+  const std::string* interned_name() const {
     return _function_name;
   }
 
+  // Configuration the task has to run on, nullptr if any will do
+  const std::string* config() const {
+    return _config;
+  }
+
+  void set_config(const std::string& bitstream) {
+    _config = intern(bitstream);
+  }
+
+  const KernelGen& kernel_gen() const {
+    return _kernel_gen;
+  }
+
+  const std::string& function_name() const {
+    return *_function_name;
+  }
+
+  Priority priority() const {
+    return _priority;
+  }
+
+  void set_priority(Priority priority) {
+    _priority = priority;
+  }
+
+  // When the task should be finished, TimePoint::max() if it has no deadline
+  TimePoint deadline() const {
+    return _deadline;
+  }
+
+  bool has_deadline() const {
+    return _deadline != TimePoint::max();
+  }
+
+  void set_deadline(TimePoint deadline) {
+    _deadline = deadline;
+  }
+
+  // Seconds the scheduler expects the task to take, set on submission of
+  // tasks with a deadline
+  float predicted() const {
+    return _predicted;
+  }
+
+  void set_predicted(float seconds) {
+    _predicted = seconds;
+  }
+
+  // Latest time the task can start and still meet its deadline
+  TimePoint latest_start() const {
+    if (!has_deadline()) {
+      return TimePoint::max();
+    }
+    return _deadline - std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<float>(_predicted));
+  }
+
   cl::NDRange offset() const {
     return _dims.offset;
   }
@@ -112,6 +252,89 @@ public:
     return _dims.local;
   }
 
+  // Whether the caller chose the local size
+  bool has_local() const {
+    return _dims.local.dimensions() > 0;
+  }
+
+  // Number of elements the kernel works on. Defaults to the size of the
+  // global range, single work-item kernels have to set it explicitly.
+  std::size_t problem_size() const
+  {
+    if (_problem_size > 0) {
+      return _problem_size;
+    }
+    std::size_t size = 1;
+    for (std::size_t d = 0; d < _dims.global.dimensions(); d++) {
+      size *= _dims.global[d];
+    }
+    return size;
+  }
+
+  void set_problem_size(std::size_t size)
+  {
+    _problem_size = size;
+  }
+
+  // Bytes copied between host and device on behalf of this task
+  std::size_t transfer_bytes() const
+  {
+    return _transfer_bytes;
+  }
+
+  void set_transfer_bytes(std::size_t bytes)
+  {
+    _transfer_bytes = bytes;
+  }
+
+  // Identifies the buffers and arguments of the task, the scheduler may
+  // launch adjacent tasks of a kernel with the same non-zero key as one
+  uint64_t coalesce_key() const {
+    return _coalesce_key;
+  }
+
+  void set_coalesce_key(uint64_t key) {
+    _coalesce_key = key;
+  }
+
+  // Called on the queue thread once the task has finished, after the
+  // scheduler logged it. Tasks with one are neither split nor coalesced.
+  const Completion& completion() const {
+    return _completion;
+  }
+
+  void set_completion(Completion completion) {
+    _completion = std::move(completion);
+  }
+
+  // Submitted tasks this launch stands for, more than one once coalesced
+  uint32_t merged() const {
+    return _merged;
+  }
+
+  void set_merged(uint32_t merged) {
+    _merged = merged;
+  }
+
+  // Nanoseconds MultiDeviceScheduler added to the backlog of the task's
+  // device, it takes exactly these off again once the task has finished
+  int64_t backlog_ns() const {
+    return _backlog_ns;
+  }
+
+  void set_backlog_ns(int64_t backlog_ns) {
+    _backlog_ns = backlog_ns;
+  }
+
+  // CL_SUCCESS unless the stream could not launch the task
+  cl_int status() const {
+    return _status;
+  }
+
+  void set_status(cl_int status) {
+    _status = status;
+  }
+
   std::chrono::duration<double> duration() const {
     return _finished_at - _enqueued_at;
   }
@@ -123,15 +346,29 @@ public:
   }
 
 private:
-  uint64_t    _id;
-  TimePoint   _created_at;
-  TimePoint   _enqueued_at;
-  TimePoint   _finished_at;
-  cl::Kernel  _kernel;
-  cl::Event   _kernel_done;
-  std::string _function_name;
-  KernelGen   _kernel_gen;
-  TaskDims    _dims;
+  // Hot: queues, callbacks and metrics
+  uint64_t           _id = 0;
+  const std::string* _function_name;
+  TimePoint          _created_at;
+  TimePoint          _enqueued_at;
+  TimePoint          _started_at;
+  TimePoint          _finished_at;
+  std::size_t        _problem_size   = 0;
+  std::size_t        _transfer_bytes = 0;
+  // Cold: launch, placement and ordering only
+  const std::string* _config       = nullptr;
+  TimePoint          _deadline     = TimePoint::max();
+  uint64_t           _coalesce_key = 0;
+  int64_t            _backlog_ns   = 0;
+  float              _predicted    = 0;
+  uint32_t           _merged       = 1;
+  cl_int             _status       = CL_SUCCESS;
+  Priority           _priority     = Priority::Normal;
+  KernelGen          _kernel_gen;
+  Completion         _completion;
+  TaskDims           _dims;
+  cl::Kernel         _kernel;
+  cl::Event          _kernel_done;
 };
 
 using Tasks = std::deque<Task>;
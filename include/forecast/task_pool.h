@@ -0,0 +1,178 @@
+#pragma once
+
+#include "task.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace forecast {
+
+/**
+ * Slab of task slots. Slots come in blocks that are kept until the pool is
+ * destroyed, released slots are reused first, so a queue in steady state
+ * does not allocate. Not thread-safe, the owner guards it.
+ */
+class TaskPool {
+public:
+  explicit TaskPool(std::size_t block_size = 64)
+    : _block_size(block_size)
+  {
+  }
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  // All tasks have to be released before
+  ~TaskPool()
+  {
+    assert(_free.size() == capacity());
+  }
+
+  Task* acquire(Task&& task)
+  {
+    if (_free.empty()) {
+      grow();
+    }
+    void* slot = _free.back();
+    _free.pop_back();
+    return new (slot) Task(std::move(task));
+  }
+
+  void release(Task* task)
+  {
+    task->~Task();
+    _free.push_back(task);
+  }
+
+  std::size_t capacity() const
+  {
+    return _blocks.size() * _block_size;
+  }
+
+private:
+  using Slot = std::aligned_storage_t<sizeof(Task), alignof(Task)>;
+
+  void grow()
+  {
+    _blocks.push_back(std::make_unique<Slot[]>(_block_size));
+    _free.reserve(capacity());
+    for (std::size_t i = _block_size; i > 0; i--) {
+      _free.push_back(std::addressof(_blocks.back()[i - 1]));
+    }
+  }
+
+  std::size_t                          _block_size;
+  std::vector<std::unique_ptr<Slot[]>> _blocks;
+  std::vector<void*>                   _free;
+};
+
+// FIFO of pooled tasks on a ring that only grows
+class TaskRing {
+public:
+  bool empty() const
+  {
+    return _size == 0;
+  }
+
+  std::size_t size() const
+  {
+    return _size;
+  }
+
+  Task* front() const
+  {
+    assert(!empty());
+    return _slots[_head];
+  }
+
+  void push(Task* task)
+  {
+    if (_size == _slots.size()) {
+      grow();
+    }
+    _slots[(_head + _size) % _slots.size()] = task;
+    _size++;
+  }
+
+  Task* pop()
+  {
+    auto* task = front();
+    _head      = (_head + 1) % _slots.size();
+    _size--;
+    return task;
+  }
+
+private:
+  void grow()
+  {
+    std::vector<Task*> slots(std::max<std::size_t>(16, 2 * _slots.size()));
+    for (std::size_t i = 0; i < _size; i++) {
+      slots[i] = _slots[(_head + i) % _slots.size()];
+    }
+    _slots = std::move(slots);
+    _head  = 0;
+  }
+
+  std::vector<Task*> _slots;
+  std::size_t        _head = 0;
+  std::size_t        _size = 0;
+};
+
+/**
+ * Pooled tasks by urgency: higher priority first, then the earliest latest
+ * start (least slack), then submission order. Tasks without a deadline
+ * come after those with one of the same priority.
+ */
+class TaskHeap {
+public:
+  bool empty() const
+  {
+    return _tasks.empty();
+  }
+
+  std::size_t size() const
+  {
+    return _tasks.size();
+  }
+
+  Task* front() const
+  {
+    assert(!empty());
+    return _tasks.front();
+  }
+
+  void push(Task* task)
+  {
+    _tasks.push_back(task);
+    std::push_heap(_tasks.begin(), _tasks.end(), runs_later);
+  }
+
+  Task* pop()
+  {
+    auto* task = front();
+    std::pop_heap(_tasks.begin(), _tasks.end(), runs_later);
+    _tasks.pop_back();
+    return task;
+  }
+
+private:
+  static bool runs_later(const Task* a, const Task* b)
+  {
+    if (a->priority() != b->priority()) {
+      return a->priority() < b->priority();
+    }
+    if (a->latest_start() != b->latest_start()) {
+      return a->latest_start() > b->latest_start();
+    }
+    return a->id() > b->id();
+  }
+
+  std::vector<Task*> _tasks;
+};
+
+}  // namespace forecast
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "task.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <log.h>
+
+namespace forecast {
+
+struct TraceEvent {
+  std::string name;
+  const char* category = "";
+  // Chrome trace phase, 'X' for spans and 'i' for instants
+  char        phase = 'X';
+  TimePoint   begin;
+  TimePoint   end;
+  uint64_t    id = 0;
+  std::string detail;
+};
+
+/**
+ * Events of one thread. Only the owning thread appends, readers see every
+ * event below the released size, so recording takes no lock. Events are
+ * preallocated and names reuse their storage; a full buffer drops events.
+ * The tid and name belong to the Tracer's lock.
+ */
+class TraceBuffer {
+public:
+  TraceBuffer(uint32_t tid, std::size_t capacity)
+    : _tid(tid)
+    , _name("thread " + std::to_string(tid))
+    , _events(capacity)
+  {
+  }
+
+  template <typename Fill>
+  void push(Fill&& fill)
+  {
+    const auto n = _size.load(std::memory_order_relaxed);
+    if (n == _events.size()) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    fill(_events[n]);
+    _size.store(n + 1, std::memory_order_release);
+  }
+
+  std::size_t size() const
+  {
+    return _size.load(std::memory_order_acquire);
+  }
+
+  const TraceEvent& operator[](std::size_t i) const
+  {
+    return _events[i];
+  }
+
+  std::size_t dropped() const
+  {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+  // Only while the owning thread does not record
+  void clear()
+  {
+    _size.store(0, std::memory_order_release);
+    _dropped.store(0, std::memory_order_relaxed);
+  }
+
+  uint32_t tid() const
+  {
+    return _tid;
+  }
+
+  // Hands the empty buffer to a new thread
+  void reset(uint32_t tid)
+  {
+    _tid  = tid;
+    _name = "thread " + std::to_string(tid);
+  }
+
+  const std::string& name() const
+  {
+    return _name;
+  }
+
+  void set_name(const std::string& name)
+  {
+    _name = name;
+  }
+
+private:
+  uint32_t                 _tid;
+  std::string              _name;
+  std::vector<TraceEvent>  _events;
+  std::atomic<std::size_t> _size{0};
+  std::atomic<std::size_t> _dropped{0};
+};
+
+/**
+ * Opt-in timeline of the task lifecycle in the Chrome trace format, which
+ * chrome://tracing and Perfetto open. Every thread records into its own
+ * buffer, a disabled tracer costs one relaxed load per event.
+ */
+class Tracer {
+public:
+  Tracer()
+    : _epoch(Clock::now())
+  {
+  }
+
+  void enable(std::size_t events_per_thread = 1 << 16)
+  {
+    _capacity = events_per_thread;
+    _enabled.store(true, std::memory_order_relaxed);
+  }
+
+  bool enabled() const
+  {
+    return _enabled.load(std::memory_order_relaxed);
+  }
+
+  void set_thread_name(const std::string& name)
+  {
+    if (!enabled()) return;
+    auto&                       buffer = local();
+    std::lock_guard<std::mutex> lg(_m);
+    buffer.set_name(name);
+  }
+
+  void span(
+      const std::string& name,
+      const char*        category,
+      TimePoint          begin,
+      TimePoint          end,
+      uint64_t           id     = 0,
+      const std::string& detail = "")
+  {
+    if (!enabled()) return;
+    local().push([&](TraceEvent& e) {
+      e.name     = name;
+      e.category = category;
+      e.phase    = 'X';
+      e.begin    = begin;
+      e.end      = end;
+      e.id       = id;
+      e.detail   = detail;
+    });
+  }
+
+  void instant(
+      const std::string& name,
+      const char*        category,
+      const std::string& detail = "")
+  {
+    if (!enabled()) return;
+    const auto now = Clock::now();
+    local().push([&](TraceEvent& e) {
+      e.name     = name;
+      e.category = category;
+      e.phase    = 'i';
+      e.begin    = now;
+      e.end      = now;
+      e.id       = 0;
+      e.detail   = detail;
+    });
+  }
+
+  // The lifecycle of a finished task, called once its callback returned
+  void task(const Task& task, TimePoint callback_done)
+  {
+    if (!enabled()) return;
+    const auto& name = task.function_name();
+    span("pending", "queue", task.created_at(), task.enqueued_at(), task.id());
+    span("launch", "queue", task.enqueued_at(), task.started_at(), task.id());
+    span(name, "device", task.started_at(), task.finished_at(), task.id());
+    span("callback", "host", task.finished_at(), callback_done, task.id());
+  }
+
+  // Only while no thread records
+  bool write(const std::string& path)
+  {
+    std::ofstream out(path);
+    if (!out) {
+      warn("Could not write trace to {}", path);
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lg(_m);
+    std::size_t                 events = 0, dropped = 0;
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    auto sep   = [&out, &first]() {
+      out << (first ? "" : ",\n");
+      first = false;
+    };
+    for (const auto& buffer : _buffers) {
+      sep();
+      out << R"({"ph":"M","pid":1,"tid":)" << buffer->tid()
+          << R"(,"name":"thread_name","args":{"name":")"
+          << escape(buffer->name()) << "\"}}";
+      const auto size = buffer->size();
+      for (std::size_t i = 0; i < size; i++) {
+        const auto& e = (*buffer)[i];
+        sep();
+        out << R"({"ph":")" << e.phase << R"(","pid":1,"tid":)"
+            << buffer->tid() << R"(,"name":")" << escape(e.name)
+            << R"(","cat":")" << e.category << R"(","ts":)"
+            << micros(e.begin - _epoch);
+        if (e.phase == 'X') {
+          out << R"(,"dur":)" << micros(e.end - e.begin);
+        } else {
+          out << R"(,"s":"p")";
+        }
+        out << R"(,"args":{"id":)" << e.id;
+        if (!e.detail.empty()) {
+          out << R"(,"detail":")" << escape(e.detail) << "\"";
+        }
+        out << "}}";
+      }
+      events += size;
+      dropped += buffer->dropped();
+    }
+    out << "\n]}\n";
+    info("Wrote {} trace events to {} ({} dropped)", events, path, dropped);
+    return static_cast<bool>(out);
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    for (auto& buffer : _buffers) {
+      buffer->clear();
+    }
+  }
+
+private:
+  // Hands the buffer of a thread back to the tracer when the thread exits
+  struct Owner {
+    Tracer*      tracer = nullptr;
+    TraceBuffer* buffer = nullptr;
+
+    ~Owner()
+    {
+      if (buffer) {
+        tracer->release(buffer);
+      }
+    }
+  };
+
+  // Buffers belong to the tracer and outlive their threads. A new thread
+  // takes over the buffer of one that has exited once clear() has drained
+  // it, under a tid and name of its own. Between clears there are as many
+  // buffers as threads.
+  TraceBuffer& local()
+  {
+    thread_local Owner owner;
+    if (!owner.buffer) {
+      std::lock_guard<std::mutex> lg(_m);
+      auto drained = std::find_if(
+          _free.begin(), _free.end(), [](const TraceBuffer* buffer) {
+            return buffer->size() == 0 && buffer->dropped() == 0;
+          });
+      if (drained == _free.end()) {
+        _buffers.push_back(
+            std::make_unique<TraceBuffer>(_next_tid++, _capacity));
+        owner.buffer = _buffers.back().get();
+      } else {
+        owner.buffer = *drained;
+        owner.buffer->reset(_next_tid++);
+        _free.erase(drained);
+      }
+      owner.tracer = this;
+    }
+    return *owner.buffer;
+  }
+
+  void release(TraceBuffer* buffer)
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    _free.push_back(buffer);
+  }
+
+  static double micros(Clock::duration d)
+  {
+    return std::chrono::duration<double, std::micro>(d).count();
+  }
+
+  static std::string escape(const std::string& s)
+  {
+    std::string escaped;
+    for (const auto c : s) {
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+      }
+      escaped += c;
+    }
+    return escaped;
+  }
+
+  TimePoint                                 _epoch;
+  std::atomic<bool>                         _enabled{false};
+  std::size_t                               _capacity = 1 << 16;
+  std::mutex                                _m;
+  std::vector<std::unique_ptr<TraceBuffer>> _buffers;
+  // Of exited threads
+  std::vector<TraceBuffer*>                 _free;
+  uint32_t                                  _next_tid = 1;
+};
+
+Tracer& tracer()
+{
+  static Tracer tracer;
+  return tracer;
+}
+
+}  // namespace forecast
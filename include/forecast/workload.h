@@ -0,0 +1,318 @@
+#pragma once
+
+#include "scheduler.h"
+#include "simulator.h"
+#include "task.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace forecast {
+
+using Rng = std::mt19937_64;
+
+/**
+ * Walker's alias method, samples a discrete distribution in O(1) with one
+ * uniform column and one biased coin flip.
+ */
+class AliasTable {
+public:
+  AliasTable() = default;
+
+  explicit AliasTable(const std::vector<double>& weights)
+    : _prob(weights.size(), 1)
+    , _alias(weights.size())
+  {
+    const auto   n   = weights.size();
+    const double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+    std::vector<double>      scaled(n);
+    std::vector<std::size_t> small, large;
+    for (std::size_t i = 0; i < n; i++) {
+      _alias[i] = i;
+      scaled[i] = weights[i] * n / sum;
+      (scaled[i] < 1 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+      const auto s = small.back();
+      const auto l = large.back();
+      small.pop_back();
+      _prob[s]  = scaled[s];
+      _alias[s] = l;
+      scaled[l] -= 1 - scaled[s];
+      if (scaled[l] < 1) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+  }
+
+  std::size_t size() const
+  {
+    return _prob.size();
+  }
+
+  template <typename Generator>
+  std::size_t operator()(Generator& rng) const
+  {
+    assert(!_prob.empty());
+    const auto column =
+        std::uniform_int_distribution<std::size_t>(0, _prob.size() - 1)(rng);
+    return std::uniform_real_distribution<double>()(rng) < _prob[column]
+               ? column
+               : _alias[column];
+  }
+
+private:
+  std::vector<double>      _prob;
+  std::vector<std::size_t> _alias;
+};
+
+// When tasks arrive, every generator owns its own process
+class ArrivalProcess {
+public:
+  virtual ~ArrivalProcess() = default;
+
+  // Seconds from the previous arrival to the next one
+  virtual double next(Rng& rng) = 0;
+};
+
+// Independent arrivals at a constant rate per second
+class PoissonArrivals : public ArrivalProcess {
+public:
+  explicit PoissonArrivals(double rate)
+    : _gap(rate)
+  {
+  }
+
+  double next(Rng& rng) override
+  {
+    return _gap(rng);
+  }
+
+private:
+  std::exponential_distribution<double> _gap;
+};
+
+/**
+ * On/off arrivals with the same mean rate as PoissonArrivals(rate): bursts
+ * of mean length burst_length seconds arrive at rate / duty, nothing
+ * arrives in between.
+ */
+class BurstyArrivals : public ArrivalProcess {
+public:
+  BurstyArrivals(double rate, double burst_length, double duty = 0.1)
+    : _gap(rate / duty)
+    , _on(1 / burst_length)
+    , _off(duty / (burst_length * (1 - duty)))
+  {
+  }
+
+  double next(Rng& rng) override
+  {
+    double gap = 0;
+    for (;;) {
+      if (_remaining <= 0) {
+        gap += _off(rng);
+        _remaining = _on(rng);
+      }
+      const auto arrival = _gap(rng);
+      if (arrival <= _remaining) {
+        _remaining -= arrival;
+        return gap + arrival;
+      }
+      gap += _remaining;
+      _remaining = 0;
+    }
+  }
+
+private:
+  std::exponential_distribution<double> _gap;
+  std::exponential_distribution<double> _on;
+  std::exponential_distribution<double> _off;
+  double                                _remaining = 0;
+};
+
+// Replays the inter-arrival times of a recorded trace, wrapping around
+class TraceArrivals : public ArrivalProcess {
+public:
+  explicit TraceArrivals(const Trace& trace, double speedup = 1)
+  {
+    for (std::size_t i = 1; i < trace.size(); i++) {
+      _gaps.push_back((trace[i].arrival - trace[i - 1].arrival) / speedup);
+    }
+    if (_gaps.empty()) {
+      _gaps.push_back(0);
+    }
+  }
+
+  double next(Rng&) override
+  {
+    const auto gap = _gaps[_next];
+    _next          = (_next + 1) % _gaps.size();
+    return gap;
+  }
+
+private:
+  std::vector<double> _gaps;
+  std::size_t         _next = 0;
+};
+
+struct WorkloadKernel {
+  const std::string* name;
+  KernelGen          kernel_gen;
+  TaskDims           dims;
+};
+
+class WorkloadGenerator;
+
+/**
+ * A mix of kernels with relative weights. The kernels must not change
+ * while generators are alive, they refer to them.
+ */
+class Workload {
+public:
+  explicit Workload(unsigned seed = 42)
+    : _seed(seed)
+  {
+  }
+
+  void add_kernel(
+      double             weight,
+      const std::string& name,
+      KernelGen          kernel_gen,
+      TaskDims           dims = TaskDims())
+  {
+    _kernels.push_back({intern(name), std::move(kernel_gen), dims});
+    _weights.push_back(weight);
+    _table = AliasTable(_weights);
+  }
+
+  const WorkloadKernel& kernel(std::size_t index) const
+  {
+    return _kernels[index];
+  }
+
+  const AliasTable& table() const
+  {
+    return _table;
+  }
+
+  // Independent and reproducible stream of tasks, one per submitting thread
+  WorkloadGenerator generator(
+      std::unique_ptr<ArrivalProcess> arrivals, unsigned stream = 0) const;
+
+private:
+  unsigned                    _seed;
+  std::vector<WorkloadKernel> _kernels;
+  std::vector<double>         _weights;
+  AliasTable                  _table;
+};
+
+class WorkloadGenerator {
+public:
+  WorkloadGenerator(
+      const Workload&                 workload,
+      std::unique_ptr<ArrivalProcess> arrivals,
+      std::seed_seq&                  seed)
+    : _workload(std::addressof(workload))
+    , _arrivals(std::move(arrivals))
+    , _rng(seed)
+  {
+  }
+
+  // Seconds until the next task arrives
+  double next_gap()
+  {
+    return _arrivals->next(_rng);
+  }
+
+  Task next_task()
+  {
+    const auto& kernel = _workload->kernel(_workload->table()(_rng));
+    // Refer to the generator of the workload instead of copying it, a
+    // pointer fits into the small buffer of std::function
+    const KernelGen* gen = std::addressof(kernel.kernel_gen);
+    return Task(
+        kernel.name,
+        [gen](const cl::Program& prg, const std::string& name) {
+          return (*gen)(prg, name);
+        },
+        kernel.dims);
+  }
+
+private:
+  const Workload*                 _workload;
+  std::unique_ptr<ArrivalProcess> _arrivals;
+  Rng                             _rng;
+};
+
+WorkloadGenerator Workload::generator(
+    std::unique_ptr<ArrivalProcess> arrivals, unsigned stream) const
+{
+  std::seed_seq seed{_seed, stream};
+  return WorkloadGenerator(*this, std::move(arrivals), seed);
+}
+
+/**
+ * Submit count tasks at the times of the arrival process, no matter how
+ * many are still pending. time_scale converts the seconds of the process to
+ * wall-clock seconds. Returns the largest delay of a submission behind its
+ * schedule in wall-clock seconds.
+ */
+double run_open_loop(
+    Scheduler&         scheduler,
+    WorkloadGenerator& generator,
+    std::size_t        count,
+    double             time_scale = 1)
+{
+  auto   next = Clock::now();
+  double lag  = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    next += std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(generator.next_gap() * time_scale));
+    Clock::sleep_until(next);
+    const std::chrono::duration<double> late = Clock::now() - next;
+    lag = std::max(lag, late.count());
+    scheduler.add_task(generator.next_task());
+  }
+  return lag;
+}
+
+// Submission to completion latency of finished tasks, thread-safe
+class LatencyRecorder {
+public:
+  void record(const Task& task)
+  {
+    const std::chrono::duration<double> latency =
+        task.finished_at() - task.created_at();
+    std::lock_guard<std::mutex> lg(_m);
+    _latencies.push_back(latency.count());
+  }
+
+  std::vector<double> sorted() const
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    auto                        latencies = _latencies;
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lg(_m);
+    _latencies.clear();
+  }
+
+private:
+  mutable std::mutex  _m;
+  std::vector<double> _latencies;
+};
+
+}  // namespace forecast
@@ -61,3 +61,14 @@ auto get_devices(size_t req_platform = 0, size_t req_device = 0)
   return std::vector<cl::Device>{devices[req_device]};
 }
 
+// All devices of a platform, e.g. for one ClBackend per board
+auto get_all_devices(size_t req_platform = 0)
+{
+  std::vector<cl::Platform> platforms;
+  cl::Platform::get(&platforms);
+  assert(platforms.size() > req_platform);
+  std::vector<cl::Device> devices;
+  platforms[req_platform].getDevices(CL_DEVICE_TYPE_ALL, &devices);
+  return devices;
+}
+
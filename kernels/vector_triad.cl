@@ -15,6 +15,18 @@
 }
 
 
+// One work-item per element, so it can be launched on any sub-range of the
+// arrays through the global offset, see forecast::Granularity
+ __kernel void vector_triad_nd(
+    __global float* restrict A,
+    __global float* restrict B,
+    __global float* restrict C,
+    __global float* restrict D)
+{
+  const size_t i = get_global_id(0);
+  A[i] = B[i] * C[i] + D[i];
+}
+
 #if NUM_KERNELS > 1
  __kernel void vector_triad2(
     __global float* restrict A,